@@ -0,0 +1,681 @@
+/**
+ * @file bench.cpp
+ * @copyright
+ * Copyright 2023 Lance Warden.
+ * Licensed under MIT or Apache 2.0 License, see LICENSE-MIT or LICENSE-APACHE for details.
+ * @brief Micro-benchmarks of every simplex construct and matching engine, with std::regex as the baseline.
+ *
+ * Every construct is matched against inputs of increasing size that it consumes entirely, by a runtime Simplex, a compiled
+ * expression (C++20), a stream_matcher fed in chunks, and the equivalent std::regex. The results are printed as JSON, one
+ * object per construct, size and engine, with the time per match and per byte of input, so releases can be compared.
+ *
+ * Workloads run mixes of expressions through the matching, search and batch APIs over generated corpora shaped like real
+ * traffic (access logs, CSV rows, identifiers, HTTP request lines and binary noise), reporting the throughput in GB/s and the
+ * p50/p99 latency per input. The corpora are generated from a fixed seed, so every run measures the same inputs.
+ *
+ * build: c++ -std=c++20 -O2 -pthread -o bench bench.cpp
+ * usage: bench [-t MS] [-c MIB] [CONSTRUCT|WORKLOAD...]
+ */
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "simplex.hpp"
+
+namespace
+{
+    /// @brief sizes of the inputs, each construct is measured up to its own maximum
+    constexpr size_t sizes[] = {16, 256, 4096, 65536, size_t(1) << 20};
+    /// @brief largest input matched by std::regex, whose recursive executor may overflow the stack on longer inputs
+    constexpr size_t regex_max_size = 4096;
+    /// @brief size of the chunks fed to a stream_matcher
+    constexpr size_t chunk_size = 4096;
+
+    /// @brief keeps the results of the measured calls alive
+    volatile size_t sink;
+
+    std::string repeat(std::string_view unit, size_t n)
+    {
+        std::string s;
+        s.reserve(unit.size() * n);
+        for (size_t i = 0; i < n; ++i)
+            s.append(unit);
+        return s;
+    }
+
+    /// @brief n lowercase letters, "abc...zab..."
+    std::string letters(size_t n)
+    {
+        std::string s(n, '\0');
+        for (size_t i = 0; i < n; ++i)
+            s[i] = char('a' + i % 26);
+        return s;
+    }
+
+    /// @brief n bytes of UTF-8, runs of lowercase letters with a two-byte codepoint every eight characters
+    std::string utf8_letters(size_t n)
+    {
+        std::string s;
+        while (s.size() < n)
+        {
+            if (s.size() % 8 == 7 && n - s.size() >= 2)
+                s.append("é");
+            else
+                s.push_back(char('a' + s.size() % 26));
+        }
+        return s;
+    }
+
+#if __cpp_nontype_template_args >= 201911L
+    template <simplex::internal::fixed_string Expr, simplex::encoding Enc = simplex::encoding::bytes>
+    bool compiled_matches(std::string_view input) { return simplex::compiled<Expr, Enc>::matches(input); }
+#define COMPILED(...) &compiled_matches<__VA_ARGS__>
+#else
+#define COMPILED(...) nullptr
+#endif
+
+    /// @brief a construct, and its std::regex equivalent, matched against inputs of n characters
+    struct construct
+    {
+        const char *name;
+        /// @brief the simplex expression for an input of n characters and a ';'
+        std::string (*expr)(size_t n);
+        /// @brief the equivalent ECMAScript regex, nullptr if std::regex has none
+        std::string (*regex)(size_t n);
+        /// @brief n characters consumed by the construct, followed by the ';' that ends every expression, so no engine can stop early
+        std::string (*input)(size_t n);
+        simplex::encoding enc;
+        /// @brief the largest input, smaller for constructs whose expression grows with the input
+        size_t max_size;
+        /// @brief the compiled expression, nullptr if the expression depends on n or compiled expressions are unavailable (C++17)
+        bool (*compiled)(std::string_view input);
+    };
+
+    const construct constructs[] = {
+        {"literal", [](size_t n)
+         { return letters(n) + ";"; },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, 4096, nullptr},
+        {"not", [](size_t n)
+         { return repeat("!;", n) + ";"; },
+         [](size_t n)
+         { return repeat("[^;]", n) + ";"; },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, 4096, nullptr},
+        {"any_group", [](size_t n)
+         { return repeat("[-az-AZ-09_]", n) + ";"; },
+         [](size_t n)
+         { return repeat("[a-zA-Z0-9_]", n) + ";"; },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, 4096, nullptr},
+        {"optional", [](size_t n)
+         {
+             std::string s;
+             for (char c : letters(n))
+                 s += {'?', c};
+             return s + ";";
+         },
+         [](size_t n)
+         {
+             std::string s;
+             for (char c : letters(n))
+                 s += {c, '?'};
+             return s + ";";
+         },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, 4096, nullptr},
+        {"star", [](size_t)
+         { return std::string("*[-az];"); },
+         [](size_t)
+         { return std::string("[a-z]*;"); },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, sizes[std::size(sizes) - 1], COMPILED("*[-az];")},
+        {"plus", [](size_t)
+         { return std::string("+[-az];"); },
+         [](size_t)
+         { return std::string("[a-z]+;"); },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, sizes[std::size(sizes) - 1], COMPILED("+[-az];")},
+        {"bounded", [](size_t n)
+         { return "{" + std::to_string(n / 2) + "," + std::to_string(n) + "}[-az];"; },
+         [](size_t n)
+         { return "[a-z]{" + std::to_string(n / 2) + "," + std::to_string(n) + "};"; },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, sizes[std::size(sizes) - 1], nullptr},
+        {"star_literal", [](size_t)
+         { return std::string("*a;"); },
+         [](size_t)
+         { return std::string("a*;"); },
+         [](size_t n)
+         { return std::string(n, 'a') + ";"; },
+         simplex::encoding::bytes, sizes[std::size(sizes) - 1], COMPILED("*a;")},
+        {"star_not", [](size_t)
+         { return std::string("*!;;"); },
+         [](size_t)
+         { return std::string("[^;]*;"); },
+         [](size_t n)
+         { return letters(n) + ";"; },
+         simplex::encoding::bytes, sizes[std::size(sizes) - 1], COMPILED("*!;;")},
+        {"star_utf8", [](size_t)
+         { return std::string("*[-az-àÿ];"); },
+         nullptr,
+         [](size_t n)
+         { return utf8_letters(n) + ";"; },
+         simplex::encoding::utf8, sizes[std::size(sizes) - 1], COMPILED("*[-az-àÿ];", simplex::encoding::utf8)},
+    };
+
+    /// @brief the fastest time per call of a measured function
+    struct measurement
+    {
+        double ns{0};
+        size_t iterations{0};
+    };
+
+    /// @brief hide a pointer from the optimizer, so calls with the same input are not hoisted out of a measured loop
+    const char *opaque(const char *p)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : "+r"(p));
+        return p;
+#else
+        const char *volatile hidden = p;
+        return hidden;
+#endif
+    }
+
+    /// @brief time batches of calls, doubling the batch until it lasts a fifth of min_time, then keep the fastest of five batches
+    template <typename F>
+    measurement measure(F &&f, std::string_view input, std::chrono::nanoseconds min_time)
+    {
+        using clock = std::chrono::steady_clock;
+        auto batch = [&f, input](size_t n)
+        {
+            auto start = clock::now();
+            for (size_t i = 0; i < n; ++i)
+                sink = sink + f(std::string_view(opaque(input.data()), input.size()));
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        };
+        size_t n{1};
+        while (batch(n) < min_time / 5 && n < (size_t(1) << 30))
+            n *= 2;
+        measurement m{0, n * 5};
+        for (int i = 0; i < 5; ++i)
+        {
+            double ns = double(batch(n).count()) / double(n);
+            if (i == 0 || ns < m.ns)
+                m.ns = ns;
+        }
+        return m;
+    }
+
+    /// @brief write a string as a JSON string
+    void json_string(std::string_view s)
+    {
+        std::fputc('"', stdout);
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                std::fputc('\\', stdout), std::fputc(c, stdout);
+            else if (static_cast<unsigned char>(c) < 0x20)
+                std::fprintf(stdout, "\\u%04x", unsigned(c));
+            else
+                std::fputc(c, stdout);
+        }
+        std::fputc('"', stdout);
+    }
+
+    class report
+    {
+        bool first{true};
+
+    public:
+        void result(const construct &c, std::string_view expr, std::string_view regex, size_t size, const char *engine, measurement m)
+        {
+            std::fputs(first ? "\n    " : ",\n    ", stdout);
+            first = false;
+            std::fputs("{\"construct\": ", stdout), json_string(c.name);
+            std::fputs(", \"expr\": ", stdout), json_string(expr.size() > 64 ? std::string(expr.substr(0, 61)) + "..." : std::string(expr));
+            std::fputs(", \"regex\": ", stdout), json_string(regex.size() > 64 ? std::string(regex.substr(0, 61)) + "..." : std::string(regex));
+            std::fprintf(stdout, ", \"size\": %zu, \"engine\": \"%s\", \"ns_per_match\": %.3f, \"ns_per_byte\": %.4f, \"iterations\": %zu}",
+                         size, engine, m.ns, m.ns / double(size), m.iterations);
+            std::fflush(stdout);
+        }
+
+        void workload(const char *name, const char *api, size_t exprs, size_t records, size_t bytes, size_t hits, double ns, const double *p50, const double *p99)
+        {
+            std::fputs(first ? "\n    " : ",\n    ", stdout);
+            first = false;
+            std::fprintf(stdout, "{\"workload\": \"%s\", \"api\": \"%s\", \"exprs\": %zu, \"records\": %zu, \"bytes\": %zu, \"hits\": %zu, \"gb_per_s\": %.3f",
+                         name, api, exprs, records, bytes, hits, double(bytes) / ns);
+            if (p50 && p99)
+                std::fprintf(stdout, ", \"p50_ns\": %.1f, \"p99_ns\": %.1f}", *p50, *p99);
+            else
+                std::fputs(", \"p50_ns\": null, \"p99_ns\": null}", stdout);
+            std::fflush(stdout);
+        }
+    };
+
+    const char *simd()
+    {
+#if defined(SIMPLEX_AVX2)
+        return "avx2";
+#elif defined(SIMPLEX_SSSE3)
+        return "ssse3";
+#elif defined(SIMPLEX_SSE2)
+        return "sse2";
+#else
+        return "none";
+#endif
+    }
+
+    /// @brief report a result that differs from the expected match of the whole input, so a broken engine is never timed
+    bool check(bool ok, const construct &c, size_t size, const char *engine)
+    {
+        if (!ok)
+            std::cerr << "bench: " << c.name << " (size " << size << "): " << engine << " does not match the input" << std::endl;
+        return ok;
+    }
+
+    /// @brief measure every engine on one construct and size
+    /// @return bool false if an engine did not match the input
+    bool run(report &out, const construct &c, size_t size, std::chrono::nanoseconds min_time)
+    {
+        std::string expr = c.expr(size), input = c.input(size);
+        Simplex<std::string> ex(c.enc, expr, simplex::capacity(expr.size()), '\0');
+        std::string_view in(input);
+        auto stream = [&ex](std::string_view in)
+        {
+            simplex::stream_matcher m = ex.stream();
+            simplex::status st = simplex::status::need_more;
+            for (size_t pos = 0; st == simplex::status::need_more && pos < in.size(); pos += chunk_size)
+                st = m.feed(in.substr(pos, chunk_size));
+            return st == simplex::status::need_more ? m.finish() : st;
+        };
+        if (!check(ex.match(in) == in.size(), c, size, "simplex") || !check(stream(in) == simplex::status::match, c, size, "stream") ||
+            !check(!c.compiled || c.compiled(in), c, size, "compiled"))
+            return false;
+        std::string regex = c.regex ? c.regex(size) : std::string();
+        out.result(c, expr, regex, size, "simplex", measure([&ex](std::string_view in)
+                                                            { return ex.match(in); },
+                                                            in, min_time));
+        if (c.compiled)
+            out.result(c, expr, regex, size, "compiled", measure([&c](std::string_view in)
+                                                                 { return size_t(c.compiled(in)); },
+                                                                 in, min_time));
+        out.result(c, expr, regex, size, "stream", measure([&stream](std::string_view in)
+                                                           { return size_t(stream(in)); },
+                                                           in, min_time));
+        if (c.regex && size <= regex_max_size)
+        {
+            std::regex re(regex);
+            auto regex_match = [&re](std::string_view in)
+            {
+                std::cmatch m;
+                return std::regex_search(in.data(), in.data() + in.size(), m, re, std::regex_constants::match_continuous) ? size_t(m.length(0)) : simplex::npos;
+            };
+            if (!check(regex_match(in) == in.size(), c, size, "std::regex"))
+                return false;
+            out.result(c, expr, regex, size, "std::regex", measure(regex_match, in, min_time));
+        }
+        return true;
+    }
+
+    /// @brief deterministic pseudo-random numbers (splitmix64), so every run generates the same corpora
+    class rng
+    {
+        uint64_t state;
+
+    public:
+        explicit rng(uint64_t seed) : state(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        size_t below(size_t n) { return size_t(next() % n); }
+
+        template <size_t N>
+        const char *pick(const char *const (&items)[N]) { return items[below(N)]; }
+
+        std::string number(size_t min, size_t max) { return std::to_string(min + below(max - min + 1)); }
+    };
+
+    const char *const words[] = {"alpha", "bravo", "index", "users", "static", "images", "logo", "api", "v1", "v2", "orders", "search", "cart", "john", "mary", "smith", "jones", "data", "report", "x"};
+
+    std::string path(rng &r)
+    {
+        std::string s;
+        for (size_t i = 0, n = 1 + r.below(4); i < n; ++i)
+            s.append("/").append(r.pick(words));
+        if (r.below(4) == 0)
+            s.append("/").append(r.number(1, 99999));
+        return s;
+    }
+
+    std::string access_log(rng &r)
+    {
+        const char *const methods[] = {"GET", "GET", "GET", "GET", "POST", "PUT", "DELETE", "HEAD"};
+        const char *const statuses[] = {"200", "200", "200", "200", "304", "301", "404", "500", "503"};
+        const char *const agents[] = {"Mozilla/5.0 (X11; Linux x86_64)", "Mozilla/5.0 (Windows NT 10.0)", "curl/8.4.0", "Googlebot/2.1", "-"};
+        return r.number(1, 255) + "." + r.number(0, 255) + "." + r.number(0, 255) + "." + r.number(1, 254) + " - - [16/Oct/2026:" + r.number(10, 23) + ":" +
+               r.number(10, 59) + ":" + r.number(10, 59) + " +0000] \"" + r.pick(methods) + " " + path(r) + " HTTP/1.1\" " + r.pick(statuses) + " " +
+               r.number(0, 99999) + " \"-\" \"" + r.pick(agents) + "\"";
+    }
+
+    std::string csv(rng &r)
+    {
+        const char *const domains[] = {"example.com", "mail.example.org", "corp.test"};
+        std::string first = r.pick(words), last = r.pick(words);
+        std::string row = r.number(1, 999999) + "," + first + "_" + last + "," + first + "." + last + "@" + r.pick(domains) + "," + r.number(0, 9999) + "." +
+                          r.number(10, 99) + ",2026-" + r.number(10, 12) + "-" + r.number(10, 28);
+        if (r.below(20) == 0)
+            row.insert(r.below(row.size()), ",,"); // a malformed row
+        return row;
+    }
+
+    std::string identifier(rng &r)
+    {
+        std::string s;
+        switch (r.below(4))
+        {
+        case 0: // snake_case
+            s = std::string(r.pick(words)) + "_" + r.pick(words);
+            break;
+        case 1: // CamelCase
+            for (size_t i = 0, n = 1 + r.below(3); i < n; ++i)
+            {
+                std::string w = r.pick(words);
+                w[0] = char(w[0] - 'a' + 'A');
+                s += w;
+            }
+            break;
+        case 2: // a long generated name
+            for (size_t i = 0, n = 16 + r.below(32); i < n; ++i)
+                s.push_back("abcdefghijklmnopqrstuvwxyz0123456789_"[r.below(37)]);
+            break;
+        default: // not an identifier
+            s = r.number(0, 999) + r.pick(words) + "-" + r.pick(words);
+        }
+        return s;
+    }
+
+    std::string request_line(rng &r)
+    {
+        const char *const methods[] = {"GET", "GET", "GET", "POST", "PUT", "PATCH", "OPTIONS", "get", "BREW"};
+        const char *const versions[] = {"HTTP/1.1", "HTTP/1.1", "HTTP/1.0", "HTTP/2", "HTTP/1.1 junk"};
+        std::string target = r.below(3) == 0 ? "/api/v1" + path(r) : path(r);
+        if (r.below(3) == 0)
+            target.append("?id=").append(r.number(1, 999999)).append("&q=").append(r.pick(words));
+        return std::string(r.pick(methods)) + " " + target + " " + r.pick(versions);
+    }
+
+    std::string noise(rng &r)
+    {
+        const char *const magics[] = {"\x89PNG\r\n", "PK\x03\x04", "\x7f" "ELF", "%PDF-1.7"};
+        std::string s = r.below(4) == 0 ? r.pick(magics) : "";
+        for (size_t i = 0, n = 16 + r.below(240); i < n; ++i)
+            s.push_back(char(r.next()));
+        return s;
+    }
+
+    /// @brief a corpus of records shaped like real traffic, and the expressions run against every record
+    struct workload
+    {
+        const char *name;
+        std::string (*record)(rng &r);
+        /// @brief whole-record shapes, matched at the beginning, and fields, found anywhere by the search APIs
+        std::vector<std::string_view> exprs;
+    };
+
+    const workload workloads[] = {
+        {"access_log", access_log, {"{1,3}[-09].{1,3}[-09].{1,3}[-09].{1,3}[-09] - - \\[", "\" 5{2,2}[-09] ", "\"POST /+![ ] HTTP/1.[-01]\"", "Mozilla/+[-09.]"}},
+        {"csv", csv, {"+[-09],+[-az_],+![,@]@+![,],+[-09].{2,2}[-09],{4,4}[-09]-{2,2}[-09]-{2,2}[-09]", "@example.com,", ",2026-10-", ",,"}},
+        {"identifiers", identifier, {"[-az-AZ_]*[-az-AZ-09_]", "+[-az]_+[-az]", "[-AZ]+[-az][-AZ]", "{20,}[-az-AZ-09_]"}},
+        {"http", request_line, {"+[-AZ] /*![ ] HTTP/1.[-01]", "GET /api/", "\\?id=+[-09]", " HTTP/2"}},
+        {"binary", noise, {"\x89PNG\r\n", "PK\x03\x04", "{8,}[- ~]", "{4,}[-\x80\xff]"}},
+    };
+
+    /// @brief the p50 and p99 of per-input latencies
+    std::pair<double, double> percentiles(std::vector<double> &ns)
+    {
+        std::sort(ns.begin(), ns.end());
+        return {ns[ns.size() / 2], ns[std::min(ns.size() - 1, ns.size() * 99 / 100)]};
+    }
+
+    /// @brief the fastest of at least three passes over a corpus, and of as many as fit in min_time
+    template <typename F>
+    double fastest_pass(F &&pass, std::chrono::nanoseconds min_time)
+    {
+        using clock = std::chrono::steady_clock;
+        double best{0};
+        std::chrono::nanoseconds total{0};
+        for (int i = 0; i < 3 || total < min_time; ++i)
+        {
+            auto start = clock::now();
+            pass();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+            total += ns;
+            if (i == 0 || double(ns.count()) < best)
+                best = double(ns.count());
+        }
+        return best;
+    }
+
+    /// @brief run the expressions of a workload through every API over a generated corpus of about corpus_size bytes
+    /// @return bool false if APIs with the same results disagree
+    bool run(report &out, const workload &w, size_t corpus_size, std::chrono::nanoseconds min_time)
+    {
+        using clock = std::chrono::steady_clock;
+        rng r(0x5173'4E58);
+        std::vector<std::string> records;
+        std::string text; // the records, one per line
+        while (text.size() < corpus_size)
+        {
+            records.push_back(w.record(r));
+            text.append(records.back()).push_back('\n');
+        }
+        std::vector<std::string_view> inputs(records.begin(), records.end());
+        std::vector<Simplex<std::string>> exprs;
+        for (std::string_view expr : w.exprs)
+            exprs.emplace_back(expr, simplex::capacity(expr.size()), '\0');
+        SimplexSet set;
+        for (const Simplex<std::string> &ex : exprs)
+            set.add(ex);
+        size_t bytes = text.size() - records.size();
+
+        // per-input APIs, timed once per input for the percentiles, and over whole passes without timers for the throughput
+        auto per_input = [&](const char *api, auto &&f)
+        {
+            std::vector<double> latencies;
+            latencies.reserve(inputs.size());
+            size_t hits{0};
+            for (std::string_view in : inputs)
+            {
+                auto start = clock::now();
+                size_t h = f(std::string_view(opaque(in.data()), in.size()));
+                latencies.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count()));
+                hits += h;
+            }
+            double ns = fastest_pass([&]
+                                     {
+                                         for (std::string_view in : inputs)
+                                             sink = sink + f(std::string_view(opaque(in.data()), in.size())); },
+                                     min_time);
+            if (latencies.empty())
+            {
+                out.workload(w.name, api, exprs.size(), inputs.size(), bytes, hits, ns, nullptr, nullptr);
+                return hits;
+            }
+            auto [p50, p99] = percentiles(latencies);
+            out.workload(w.name, api, exprs.size(), inputs.size(), bytes, hits, ns, &p50, &p99);
+            return hits;
+        };
+        size_t matched = per_input("matches", [&exprs](std::string_view in)
+                                   {
+                                       size_t hits{0};
+                                       for (const Simplex<std::string> &ex : exprs)
+                                           hits += ex.matches(in);
+                                       return hits; });
+        per_input("search", [&exprs](std::string_view in)
+                  {
+                      size_t hits{0};
+                      for (const Simplex<std::string> &ex : exprs)
+                          hits += bool(ex.search(in));
+                      return hits; });
+        size_t set_matched = per_input("SimplexSet", [&set](std::string_view in)
+                                       {
+                                           uint64_t bits{0};
+                                           set.matches(in, &bits);
+                                           return std::bitset<64>(bits).count(); });
+
+        // whole-corpus APIs, which have no per-input latency
+        std::vector<uint64_t> bits((inputs.size() + 63) / 64);
+        auto whole = [&](const char *api, auto &&f)
+        {
+            size_t hits = f();
+            double ns = fastest_pass([&f]
+                                     { sink = sink + f(); },
+                                     min_time);
+            out.workload(w.name, api, exprs.size(), inputs.size(), bytes, hits, ns, nullptr, nullptr);
+            return hits;
+        };
+        size_t batch_matched = whole("matches_batch", [&]
+                                     {
+                                         size_t hits{0};
+                                         for (const Simplex<std::string> &ex : exprs)
+                                         {
+                                             std::fill(bits.begin(), bits.end(), 0);
+                                             ex.matches_batch(inputs.data(), inputs.size(), bits.data());
+                                             for (uint64_t word : bits)
+                                                 hits += std::bitset<64>(word).count();
+                                         }
+                                         return hits; });
+        size_t counted = whole("count", [&]
+                               {
+                                   size_t hits{0};
+                                   for (const Simplex<std::string> &ex : exprs)
+                                       hits += ex.count(text);
+                                   return hits; });
+        size_t parallel_counted = whole("parallel_count", [&]
+                                        {
+                                            size_t hits{0};
+                                            for (const Simplex<std::string> &ex : exprs)
+                                                hits += ex.parallel_count(text);
+                                            return hits; });
+        if (set_matched != matched || batch_matched != matched || parallel_counted != counted)
+        {
+            std::cerr << "bench: " << w.name << ": the APIs disagree on the number of matches" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief parse a positive decimal count, or return 0 if arg is not one
+    unsigned long positive(const char *arg)
+    {
+        char *last;
+        unsigned long value = std::strtoul(arg, &last, 10);
+        return last != arg && *last == '\0' && arg[0] != '-' ? value : 0;
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: bench [-t MS] [-c MIB] [CONSTRUCT|WORKLOAD...]\n"
+                     "  -t MS   minimum time of each measurement in milliseconds (default 100)\n"
+                     "  -c MIB  size of each generated workload corpus in MiB (default 16)\n"
+                     "constructs:";
+        for (const construct &c : constructs)
+            std::cerr << ' ' << c.name;
+        std::cerr << "\nworkloads:";
+        for (const workload &w : workloads)
+            std::cerr << ' ' << w.name;
+        std::cerr << std::endl;
+        return 2;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::chrono::milliseconds min_time(100);
+    size_t corpus_size = size_t(16) << 20;
+    std::vector<const construct *> selected;
+    std::vector<const workload *> selected_workloads;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            unsigned long ms = positive(argv[++i]);
+            if (ms == 0)
+                return usage();
+            min_time = std::chrono::milliseconds(ms);
+            continue;
+        }
+        if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            unsigned long mib = positive(argv[++i]);
+            if (mib == 0 || mib > (SIZE_MAX >> 20))
+                return usage();
+            corpus_size = size_t(mib) << 20;
+            continue;
+        }
+        bool found{false};
+        for (const construct &c : constructs)
+        {
+            if (std::strcmp(argv[i], c.name) == 0)
+                selected.push_back(&c), found = true;
+        }
+        for (const workload &w : workloads)
+        {
+            if (std::strcmp(argv[i], w.name) == 0)
+                selected_workloads.push_back(&w), found = true;
+        }
+        if (!found)
+            return usage();
+    }
+    if (selected.empty() && selected_workloads.empty())
+    {
+        for (const construct &c : constructs)
+            selected.push_back(&c);
+        for (const workload &w : workloads)
+            selected_workloads.push_back(&w);
+    }
+
+    std::fprintf(stdout, "{\n  \"simd\": \"%s\",\n  \"cplusplus\": %ld,\n  \"min_time_ms\": %ld,\n  \"results\": [", simd(), long(__cplusplus), long(min_time.count()));
+    report out;
+    bool ok{true};
+    for (const construct *c : selected)
+    {
+        for (size_t size : sizes)
+        {
+            if (size <= c->max_size)
+                ok = run(out, *c, size, min_time) && ok;
+        }
+    }
+    std::fprintf(stdout, "\n  ],\n  \"corpus_size\": %zu,\n  \"workloads\": [", corpus_size);
+    report workload_out;
+    for (const workload *w : selected_workloads)
+        ok = run(workload_out, *w, corpus_size, min_time) && ok;
+    std::fputs("\n  ]\n}\n", stdout);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file simplex-grep.cpp
+ * @copyright
+ * Copyright 2023 Lance Warden.
+ * Licensed under MIT or Apache 2.0 License, see LICENSE-MIT or LICENSE-APACHE for details.
+ * @brief A grep-like command-line tool for simplex expressions (POSIX).
+ *
+ * Prints the lines of each file that contain a match of a simplex expression. Regular files are memory-mapped and scanned in place,
+ * other inputs (pipes, terminals) are read in large blocks.
+ *
+ * build: c++ -std=c++17 -O2 -o simplex-grep simplex-grep.cpp
+ * usage: simplex-grep [-c] [-o] [-b] [-u] [--] EXPR [FILE...]
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simplex.hpp"
+
+namespace
+{
+    /// @brief size of the blocks read from inputs that cannot be memory-mapped
+    constexpr size_t block_size = size_t(1) << 20;
+
+    struct options
+    {
+        /// @brief -c, only print the number of matching lines
+        bool count{false};
+        /// @brief -o, only print the matches instead of the matching lines
+        bool only_matching{false};
+        /// @brief -b, print the byte offset of each line (or match) before it
+        bool byte_offset{false};
+        /// @brief -u, the expression and the input are UTF-8, see simplex::encoding::utf8
+        bool utf8{false};
+        /// @brief print the file name before each line, if there is more than one file
+        bool file_name{false};
+    };
+
+    /// @brief scans the lines of one input and prints the results
+    class grep
+    {
+        const Simplex<std::string> &ex;
+        const options &opts;
+        const char *name;
+        size_t matched{0};
+        /// @brief length of the incomplete line carried over to the next buffer, which has no newline
+        size_t carried{0};
+
+        void prefix(size_t offset)
+        {
+            if (opts.file_name)
+                std::fputs(name, stdout), std::fputc(':', stdout);
+            if (opts.byte_offset)
+                std::fprintf(stdout, "%zu:", offset);
+        }
+
+    public:
+        grep(const Simplex<std::string> &ex, const options &opts, const char *name) : ex(ex), opts(opts), name(name) {}
+
+        /// @brief scan every complete line of a buffer
+        /// @param data the buffer
+        /// @param size the size of the buffer
+        /// @param offset the offset of the buffer within the input
+        /// @param last the buffer ends the input, so its last line is complete even without a newline
+        /// @details the incomplete line left by the previous call must begin the buffer, followed by the newly read characters
+        /// @return size_t the number of characters scanned, the rest is an incomplete line
+        size_t lines(const char *data, size_t size, size_t offset, bool last)
+        {
+            size_t pos{0};
+            while (pos < size)
+            {
+                // the carried over beginning of the first line was already searched, so long lines are only searched once
+                size_t skip = pos == 0 ? std::min(carried, size) : 0;
+                // the newline splitter shares the SIMD kernel used for runs of negated literals
+                size_t len = skip + simplex::internal::run(data + pos + skip, size - pos - skip, '\n', true);
+                if (pos + len == size && !last)
+                {
+                    carried = len;
+                    break;
+                }
+                carried = 0;
+                line(std::string_view(data + pos, len), offset + pos);
+                pos += len + 1;
+            }
+            return std::min(pos, size);
+        }
+
+        void line(std::string_view text, size_t offset)
+        {
+            if (opts.only_matching)
+            {
+                bool any{false};
+                for (std::string_view match : ex.find_all(text))
+                {
+                    if (match.empty())
+                        continue;
+                    any = true;
+                    if (opts.count)
+                        break;
+                    prefix(offset + size_t(match.data() - text.data()));
+                    std::fwrite(match.data(), 1, match.size(), stdout), std::fputc('\n', stdout);
+                }
+                matched += any;
+                return;
+            }
+            if (!ex.search(text))
+                return;
+            ++matched;
+            if (opts.count)
+                return;
+            prefix(offset);
+            std::fwrite(text.data(), 1, text.size(), stdout), std::fputc('\n', stdout);
+        }
+
+        /// @brief print the number of matching lines if counting
+        /// @return size_t the number of matching lines
+        size_t finish()
+        {
+            if (opts.count)
+            {
+                if (opts.file_name)
+                    std::fputs(name, stdout), std::fputc(':', stdout);
+                std::fprintf(stdout, "%zu\n", matched);
+            }
+            return matched;
+        }
+    };
+
+    /// @brief scan a file descriptor, memory-mapping it if it is a regular file
+    /// @return long the number of matching lines, or -1 on error
+    long scan(int fd, const char *name, const Simplex<std::string> &ex, const options &opts)
+    {
+        grep g(ex, opts, name);
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            size_t size = size_t(st.st_size);
+            void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, size, MADV_SEQUENTIAL);
+                g.lines(static_cast<const char *>(data), size, 0, true);
+                munmap(data, size);
+                return long(g.finish());
+            }
+        }
+        // not mappable, read large blocks and carry incomplete lines over to the next block
+        std::vector<char> buf(block_size);
+        size_t used{0}, offset{0};
+        for (;;)
+        {
+            if (used == buf.size())
+                buf.resize(buf.size() * 2);
+            ssize_t got = read(fd, buf.data() + used, buf.size() - used);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+            {
+                std::cerr << "simplex-grep: " << name << ": " << std::strerror(errno) << std::endl;
+                return -1;
+            }
+            used += size_t(got);
+            size_t done = g.lines(buf.data(), used, offset, got == 0);
+            std::memmove(buf.data(), buf.data() + done, used - done);
+            used -= done, offset += done;
+            if (got == 0)
+                break;
+        }
+        return long(g.finish());
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: simplex-grep [-c] [-o] [-b] [-u] [--] EXPR [FILE...]\n"
+                     "  -c  only print the number of matching lines\n"
+                     "  -o  only print the matches\n"
+                     "  -b  print the byte offset of each line or match\n"
+                     "  -u  match UTF-8 codepoints instead of bytes\n"
+                     "reads stdin if there is no FILE or FILE is '-'"
+                  << std::endl;
+        return 2;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i)
+    {
+        if (std::strcmp(argv[i], "--") == 0)
+        {
+            ++i;
+            break;
+        }
+        for (const char *flag = argv[i] + 1; *flag; ++flag)
+        {
+            switch (*flag)
+            {
+            case 'c':
+                opts.count = true;
+                break;
+            case 'o':
+                opts.only_matching = true;
+                break;
+            case 'b':
+                opts.byte_offset = true;
+                break;
+            case 'u':
+                opts.utf8 = true;
+                break;
+            default:
+                return usage();
+            }
+        }
+    }
+    if (i >= argc)
+        return usage();
+    std::string_view expr = argv[i++];
+    std::optional<Simplex<std::string>> ex;
+    try
+    {
+        ex.emplace(opts.utf8 ? simplex::encoding::utf8 : simplex::encoding::bytes, expr, simplex::capacity(expr.size()), '\0');
+    }
+    catch (const std::logic_error &e)
+    {
+        std::cerr << "simplex-grep: " << e.what() << std::endl;
+        return 2;
+    }
+
+    static char out[block_size];
+    std::setvbuf(stdout, out, _IOFBF, sizeof(out));
+    std::vector<const char *> files(argv + i, argv + argc);
+    if (files.empty())
+        files.push_back("-");
+    opts.file_name = files.size() > 1;
+    bool found{false}, failed{false};
+    for (const char *file : files)
+    {
+        bool is_stdin = std::strcmp(file, "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(file, O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "simplex-grep: " << file << ": " << std::strerror(errno) << std::endl;
+            failed = true;
+            continue;
+        }
+        long matched = scan(fd, is_stdin ? "(standard input)" : file, *ex, opts);
+        failed |= matched < 0, found |= matched > 0;
+        if (!is_stdin)
+            close(fd);
+    }
+    std::fflush(stdout);
+    return failed ? 2 : found ? 0 : 1;
+}
@@ -7,20 +7,79 @@
  */
 #ifndef SIMPLEX_HPP
 #define SIMPLEX_HPP
-#define SIMPLEX_QUANTIFY_MAX 0xFE
-#define SIMPLEX_QUANTIFY_INF 0xFF
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#include <utility>
+#endif
+
+// SIMD kernels for quantifier runs and search, define SIMPLEX_NO_SIMD to use the scalar fallback only
+#if !defined(SIMPLEX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMPLEX_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define SIMPLEX_SSSE3
+#include <tmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define SIMPLEX_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// SIMD kernels are only used outside of constant evaluation
+#if defined(__cpp_lib_is_constant_evaluated)
+#define SIMPLEX_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif (defined(__GNUC__) && __GNUC__ >= 9) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#define SIMPLEX_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define SIMPLEX_CONSTANT_EVALUATED() true
+#endif
+
+// prefetch upcoming inputs of batch matching
+#ifndef SIMPLEX_PREFETCH_DISTANCE
+#define SIMPLEX_PREFETCH_DISTANCE 8
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMPLEX_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(SIMPLEX_SSE2)
+#define SIMPLEX_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char *>(addr), _MM_HINT_T0)
+#else
+#define SIMPLEX_PREFETCH(addr) ((void)(addr))
+#endif
 
-#ifndef SIMPLEX_INF
-#define SIMPLEX_INF 0x0FFF
+// serialized images of parsed expressions are little-endian, so they are only written and used in place on little-endian hosts
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#define SIMPLEX_BIG_ENDIAN
 #endif
 
 /// @brief A simple, comptime-parsed,, one-character lookahead regex (C++17).
-/// @attention only basic ascii string literal expressions are supported (0x00-0x7F) and expression validation is not guaranteed
+/// @attention expressions are byte strings, any byte (0x00-0xFF) may be a literal, and expression validation is not guaranteed
 namespace simplex
 {
     /// @brief internal namespace for simplex
@@ -33,6 +92,22 @@ namespace simplex
         template <typename Container>
         constexpr bool is_contiguous_char_container = std::is_same<typename std::remove_reference_t<decltype(*std::begin(std::declval<Container &>()))>, char>::value && std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<decltype(std::begin(std::declval<Container &>()))>::iterator_category>::value;
 
+        /// @brief check if T is a byte type that input may be made of, i.e. char, signed char, unsigned char (uint8_t) or std::byte
+        template <typename T>
+        constexpr bool is_byte = std::is_same<T, char>::value || std::is_same<T, signed char>::value || std::is_same<T, unsigned char>::value || std::is_same<T, std::byte>::value;
+
+        /// @brief check if Iter is a pointer to char, which the SIMD kernels and wide compares take directly
+        template <typename Iter>
+        constexpr bool is_char_pointer = std::is_pointer<Iter>::value && std::is_same<std::remove_cv_t<std::remove_pointer_t<Iter>>, char>::value;
+
+        /// @brief check if Iter is a pointer to any other byte type, which is matched through a pointer to char at run time
+        template <typename Iter>
+        constexpr bool is_byte_pointer = std::is_pointer<Iter>::value && !is_char_pointer<Iter> && is_byte<std::remove_cv_t<std::remove_pointer_t<Iter>>>;
+
+        /// @brief view a pointer to bytes as a pointer to char, not a constant expression
+        template <typename T>
+        inline const char *chars(const T *p) { return reinterpret_cast<const char *>(p); }
+
         enum : uchar
         {
             /// @brief NOT op flag, invert the next matching unit
@@ -45,10 +120,16 @@ namespace simplex
             ONE_OR_MORE,
             /// @brief ZERO_OR_ONE op code, next matching unit is quantified as zero or one
             ZERO_OR_ONE,
-            /// @brief ANY op code, next matching unit is a group of characters
+            /// @brief ANY op code, next matching unit is a group of characters stored as a 256-bit membership table
             ANY,
-            /// @brief RANGE op code, next matching unit is a range of characters
-            RANGE,
+            /// @brief STRING op code, next matching unit is a run of literal characters prefixed by its length
+            STRING,
+            /// @brief CHAR op code, next matching unit is a single literal character
+            CHAR,
+            /// @brief UTF8 op code, next matching unit is a class of codepoints (see simplex::encoding::utf8), stored as a negation flag,
+            /// the first half of a membership table for its ASCII members, and ranges of its other members as varints of their first
+            /// codepoint and length minus one, ending with a zero byte
+            UTF8,
         };
 
         inline constexpr bool test_flag(const uchar flags, uchar flag)
@@ -56,239 +137,1028 @@ namespace simplex
             return (flags & flag) != uchar(0);
         }
 
-        constexpr uchar stouc(const uchar (&stack)[3], size_t i)
+        /// @brief the maximum of an unbounded quantifier, e.g. "*" or "{2,}"
+        constexpr uint64_t unbounded = ~uint64_t(0);
+
+        /// @brief size in bytes of a varint, 7 bits per byte from the least significant, with the high bit set on all but the last byte
+        constexpr size_t varint_size(uint64_t value)
+        {
+            size_t res{1};
+            for (; value >= 0x80; value >>= 7)
+                ++res;
+            return res;
+        }
+
+        /// @brief write a varint through out, called with every byte
+        template <typename Out>
+        constexpr void put_varint(Out &&out, uint64_t value)
+        {
+            for (; value >= 0x80; value >>= 7)
+                out(uchar(value | 0x80));
+            out(uchar(value));
+        }
+
+        /// @brief read the varint at pos, advancing pos past it
+        constexpr uint64_t get_varint(std::string_view expr, size_t &pos)
+        {
+            uint64_t res{0};
+            for (unsigned shift = 0;; shift += 7)
+            {
+                uchar byte = uchar(expr[pos++]);
+                res |= uint64_t(byte & 0x7F) << shift;
+                if (byte < 0x80)
+                    return res;
+            }
+        }
+
+        /// @brief size in bytes of a QUANTIFY op code and its bounds, the maximum is stored plus one so that unbounded is 0
+        constexpr size_t bounds_size(uint64_t min, uint64_t max)
+        {
+            return 1 + varint_size(min) + varint_size(max + 1);
+        }
+
+        /// @brief decode the quantifier op code at pos, if any, advancing pos past it
+        /// @return true if there is a quantifier at pos
+        constexpr bool quantifier(std::string_view expr, size_t &pos, uint64_t &min, uint64_t &max)
+        {
+            switch (uchar(expr[pos]))
+            {
+            case QUANTIFY:
+                ++pos, min = get_varint(expr, pos), max = get_varint(expr, pos) - 1;
+                return true;
+            case ZERO_OR_MORE:
+                ++pos, min = 0, max = unbounded;
+                return true;
+            case ONE_OR_MORE:
+                ++pos, min = 1, max = unbounded;
+                return true;
+            case ZERO_OR_ONE:
+                ++pos, min = 0, max = 1;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /// @brief size in bytes of a compiled ANY group, i.e. a 256-bit membership table
+        constexpr size_t any_size = 32;
+
+        /// @brief index of the byte of a membership table holding a character
+        /// @details the table is nibble-major, i.e. byte (cur & 0x80 ? 16 : 0) + (cur & 0x0F) holds bit (cur >> 4) & 7,
+        /// so each half of the table can be used directly as a 16-byte shuffle lookup by the SIMD kernels
+        inline constexpr size_t any_index(const uchar cur)
+        {
+            return size_t((cur >> 7) << 4) | (cur & 0x0Fu);
+        }
+
+        /// @brief add a character to a 256-bit membership table
+        inline constexpr void any_set(char (&set)[any_size], const uchar cur)
+        {
+            set[any_index(cur)] = char(uchar(set[any_index(cur)]) | uchar(1u << ((cur >> 4) & 7)));
+        }
+
+        /// @brief check if a character is a member of a compiled ANY group
+        /// @param set the 256-bit membership table following the ANY op code
+        /// @param cur the character to check
+        inline constexpr bool any(std::string_view set, const uchar cur)
+        { // assume set is the actual membership table
+            return (uchar(set[any_index(cur)]) >> ((cur >> 4) & 7)) & 1u;
+        }
+
+        /// @brief index of the lowest set bit of a non-zero mask
+        inline size_t lowest_bit(uint32_t mask)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return size_t(idx);
+#else
+            return size_t(__builtin_ctz(mask));
+#endif
+        }
+
+        /// @brief count the leading characters of [begin, begin + n) that are (not, if negated) equal to scur
+        inline size_t run(const char *begin, size_t n, const uchar scur, const bool negated)
+        {
+            size_t i{0};
+#if defined(SIMPLEX_AVX2)
+            const __m256i needle = _mm256_set1_epi8(char(scur));
+            for (; i + 32 <= n; i += 32)
+            {
+                uint32_t eq = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin + i)), needle)));
+                if (uint32_t stop = negated ? eq : ~eq)
+                    return i + lowest_bit(stop);
+            }
+#endif
+#if defined(SIMPLEX_SSE2)
+            const __m128i needle16 = _mm_set1_epi8(char(scur));
+            for (; i + 16 <= n; i += 16)
+            {
+                uint32_t eq = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + i)), needle16)));
+                if (uint32_t stop = negated ? eq : ~eq & 0xFFFFu)
+                    return i + lowest_bit(stop);
+            }
+#endif
+            for (; i < n && negated != (uchar(begin[i]) == scur); ++i)
+                ;
+            return i;
+        }
+
+        /// @brief count the leading characters of [begin, begin + n) that are (not, if negated) members of a compiled ANY group
+        inline size_t run(const char *begin, size_t n, std::string_view set, const bool negated)
+        {
+            size_t i{0};
+#if defined(SIMPLEX_AVX2)
+            {
+                const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.data())));
+                const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.data() + 16)));
+                const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+                const __m256i nibble = _mm256_set1_epi8(0x0F), high = _mm256_set1_epi8(char(0x80));
+                for (; i + 32 <= n; i += 32)
+                {
+                    const __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin + i));
+                    const __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lo, cur), _mm256_shuffle_epi8(hi, _mm256_xor_si256(cur, high)));
+                    const __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(cur, 4), nibble));
+                    uint32_t out = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256())));
+                    if (uint32_t stop = negated ? ~out : out)
+                        return i + lowest_bit(stop);
+                }
+            }
+#endif
+#if defined(SIMPLEX_SSSE3)
+            {
+                const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.data()));
+                const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.data() + 16));
+                const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+                const __m128i nibble = _mm_set1_epi8(0x0F), high = _mm_set1_epi8(char(0x80));
+                for (; i + 16 <= n; i += 16)
+                {
+                    const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + i));
+                    const __m128i row = _mm_or_si128(_mm_shuffle_epi8(lo, cur), _mm_shuffle_epi8(hi, _mm_xor_si128(cur, high)));
+                    const __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(cur, 4), nibble));
+                    uint32_t out = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128())));
+                    if (uint32_t stop = negated ? ~out & 0xFFFFu : out)
+                        return i + lowest_bit(stop);
+                }
+            }
+#endif
+            for (; i < n && negated != any(set, uchar(begin[i])); ++i)
+                ;
+            return i;
+        }
+
+        /// @brief size of the matching unit at pos, including its NOT flag
+        constexpr size_t unit_size(std::string_view expr, size_t pos)
         {
-            switch (i)
+            switch (uchar(expr[pos]))
             {
-            case 1:
-                return stack[0] - '0';
-            case 2:
-                return (stack[0] - '0') * 10 + (stack[1] - '0');
-            case 3:
+            case NOT:
+                return 1 + unit_size(expr, pos + 1);
+            case ANY:
+                return 1 + any_size;
+            case STRING:
+                return 2 + uchar(expr[pos + 1]);
+            case CHAR:
+                return 2;
+            case UTF8:
             {
-                uint16_t res = uint16_t(stack[0] - '0') * 100 + uint16_t(stack[1] - '0') * 10 + uint16_t(stack[2] - '0');
-                if (res > uint16_t(SIMPLEX_QUANTIFY_MAX))
-                    throw std::logic_error("simplex::parse(): malformed quantifier, maximum bound is 254");
-                return uchar(res);
+                size_t end = pos + 2 + any_size / 2;
+                while (expr[end] != '\0')
+                    get_varint(expr, end), get_varint(expr, end);
+                return end + 1 - pos;
             }
             default:
-                throw std::logic_error("simplex::parse(): malformed quantifier");
+                return 1;
             }
         }
 
-        bool any(std::string_view expr, const uchar cur)
-        { // assume expr is the actual group
-            size_t pos{0};
-            for (uchar scur = expr[pos]; scur == RANGE; scur = expr[++pos])
-            { // ranges are always two characters, otherwise it's malformed
-                if (cur >= expr[++pos] && cur <= expr[++pos])
-                    return pos;
+        /// @brief the maximum number of characters examined by a match of a parsed simplex expression, a quantifier examines up to one past its maximum
+        /// @return size_t the number of characters, std::string_view::npos if a quantifier is unbounded
+        constexpr size_t extent(std::string_view expr)
+        {
+            size_t res{0};
+            for (size_t pos = 0; pos < expr.size();)
+            {
+                uint64_t min{0}, max{0};
+                if (uchar(expr[pos]) == NOT)
+                    ++pos;
+                else if (quantifier(expr, pos, min, max))
+                {
+                    pos += uchar(expr[pos]) == NOT;
+                    // a codepoint takes up to four bytes
+                    size_t width = uchar(expr[pos]) == UTF8 ? 4 : 1;
+                    if (max >= (std::string_view::npos - res) / width - 1)
+                        return std::string_view::npos;
+                    res += (size_t(max) + 1) * width;
+                    pos += unit_size(expr, pos);
+                }
+                else
+                {
+                    res += uchar(expr[pos]) == STRING ? uchar(expr[pos + 1]) : uchar(expr[pos]) == UTF8 ? 4 : 1;
+                    pos += unit_size(expr, pos);
+                }
             }
-            return expr.find(char(cur), pos) != std::string_view::npos;
+            return res;
         }
 
+        /// @brief the codepoint returned by internal::codepoint() for a malformed UTF-8 sequence, which is never in a range of a UTF8 class
+        constexpr uint32_t malformed = 0x110000;
+        /// @brief the codepoint returned by internal::codepoint() for a UTF-8 sequence cut off by the end of the input
+        constexpr uint32_t truncated = 0x110001;
+
+        /// @brief decode the UTF-8 sequence at begin, advancing past it, cur holds *begin on entry and, if any input remains, on exit
+        /// @return uint32_t the codepoint, internal::malformed or internal::truncated, a malformed sequence ends before the first
+        /// byte that does not continue it, so that byte is read once
         template <typename Iter>
-        bool quantify(std::string_view expr, Iter &begin, const Iter &end, size_t &pos, uchar cur, const uint16_t min, const uint16_t max)
-        { // assume we have already read QUANTIFY operator
-            size_t new_pos = ++pos;
-            uint16_t cnt{0};
-            uchar flags{0}, any_len{0}, scur = expr[pos];
-            bool res{false};
-            while (cnt <= max && begin != end)
+        constexpr uint32_t codepoint(Iter &begin, const Iter &end, uchar &cur)
+        {
+            uint32_t res = cur;
+            size_t more = cur < 0x80 ? 0 : cur < 0xC2 ? 4 : cur < 0xE0 ? 1 : cur < 0xF0 ? 2 : cur < 0xF5 ? 3 : 4;
+            // the second byte excludes overlong sequences, surrogates and codepoints above 0x10FFFF
+            uchar lo = cur == 0xE0 ? 0xA0 : cur == 0xF0 ? 0x90 : 0x80, hi = cur == 0xED ? 0x9F : cur == 0xF4 ? 0x8F : 0xBF;
+            if (more == 4)
+                res = malformed, more = 0;
+            else if (more != 0)
+                res &= 0x3Fu >> more;
+            for (++begin; more != 0; --more, ++begin, lo = 0x80, hi = 0xBF)
             {
-                switch (scur)
+                if (begin == end)
+                    return truncated;
+                cur = uchar(*begin);
+                if (cur < lo || cur > hi)
+                    return malformed;
+                res = res << 6 | (cur & 0x3Fu);
+            }
+            if (begin != end)
+                cur = uchar(*begin);
+            return res;
+        }
+
+        /// @brief check if a codepoint is a member of the UTF8 class at pos
+        constexpr bool utf8_member(std::string_view expr, size_t pos, const uint32_t cp)
+        {
+            if (cp < 0x80)
+                return any(expr.substr(pos + 2, any_size / 2), uchar(cp));
+            for (size_t i = pos + 2 + any_size / 2; expr[i] != '\0';)
+            {
+                uint64_t first = get_varint(expr, i);
+                if (cp - first <= get_varint(expr, i))
+                    return expr[pos + 1] == '\0';
+            }
+            return expr[pos + 1] != '\0';
+        }
+
+        /// @brief count the leading codepoints of [begin, end) that are (not, if negated) members of the UTF8 class at pos, up to limit,
+        /// advancing past them
+        /// @param final the input ends at end, otherwise the count stops before a sequence cut off by end
+        /// @attention a codepoint is only known not to be a member after reading it, so Iter must be a forward iterator to step back
+        template <typename Iter>
+        constexpr uint64_t utf8_run(std::string_view expr, size_t pos, Iter &begin, const Iter &end, const bool negated, const uint64_t limit, const bool final)
+        {
+            uint64_t cnt{0};
+            char ascii[any_size]{};
+            for (size_t i = 0; i < any_size / 2; ++i)
+                ascii[i] = char(negated ? ~expr[pos + 2 + i] : expr[pos + 2 + i]);
+            while (cnt < limit && begin != end)
+            {
+                if constexpr (is_char_pointer<Iter>)
                 {
-                // case FLAGS: fallthrough...
-                case NOT:
-                    flags |= scur & uchar(0x7F), scur = expr[++pos], new_pos = pos;
-                    continue;
-                case QUANTIFY:
-                case ZERO_OR_MORE:
-                case ONE_OR_MORE:
-                case ZERO_OR_ONE:
-                    throw std::logic_error("simplex::matches(): malformed quantifier, nested quantifiers are not allowed");
-                case ANY:
-                    any_len = expr[pos + 1];
-                    res = any(expr.substr(pos + 2, any_len), cur);
-                    new_pos = pos + any_len + 1;
-                    break;
-                default:
-                    res = cur == scur;
+                    if (!SIMPLEX_CONSTANT_EVALUATED())
+                    { // runs of ASCII members at the speed of bytes, the empty upper half of the table stops on every other byte
+                        size_t k = run(&*begin, size_t(std::min<uint64_t>(uint64_t(end - begin), limit - cnt)), std::string_view(ascii, any_size), false);
+                        begin += k, cnt += k;
+                        if (cnt == limit || begin == end)
+                            break;
+                    }
+                }
+                uchar cur = uchar(*begin);
+                Iter at = begin;
+                uint32_t cp = codepoint(begin, end, cur);
+                if ((cp == truncated && !final) || (cp < 0x80 ? !any(std::string_view(ascii, any_size), uchar(cp)) : negated == utf8_member(expr, pos, cp)))
+                {
+                    begin = at;
                     break;
                 }
-                if (!(test_flag(flags, NOT) ^ res))
-                    return (pos = new_pos, cnt >= min);
-                ++cnt, cur = *++begin;
+                ++cnt;
+            }
+            return cnt;
+        }
+
+        /// @brief match a quantified unit, cur holds *begin on entry and, if any input remains, on exit, so every character is read once
+        template <typename Iter>
+        constexpr bool quantify(std::string_view expr, Iter &begin, const Iter &end, size_t &pos, uchar &cur, const uint64_t min, const uint64_t max)
+        { // assume we have already read the quantifier, pos is at its unit
+            bool negated = uchar(expr[pos]) == NOT;
+            uchar scur = expr[pos += negated];
+            switch (scur)
+            {
+            case NOT:
+            case QUANTIFY:
+            case ZERO_OR_MORE:
+            case ONE_OR_MORE:
+            case ZERO_OR_ONE:
+                throw std::logic_error("simplex::matches(): malformed quantifier, nested quantifiers are not allowed");
+            }
+            if (scur == UTF8)
+            {
+                if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value)
+                {
+                    size_t at = pos;
+                    pos += unit_size(expr, pos) - 1;
+                    uint64_t cnt = utf8_run(expr, at, begin, end, negated, max == unbounded ? max : max + 1, true);
+                    if (begin != end)
+                        cur = uchar(*begin);
+                    return cnt >= min && cnt <= max;
+                }
+                else
+                    throw std::logic_error("simplex::matches(): quantified UTF-8 classes need forward iterators");
+            }
+            std::string_view set;
+            uchar lit{0};
+            if (scur == ANY)
+                set = expr.substr(pos + 1, any_size), pos += any_size;
+            else
+                lit = expr[++pos];
+            uint64_t cnt{0};
+            if constexpr (is_char_pointer<Iter>)
+            {
+                if (!SIMPLEX_CONSTANT_EVALUATED())
+                { // consume the whole run at once, up to one past max
+                    size_t n = max < uint64_t(end - begin) ? size_t(max) + 1 : size_t(end - begin);
+                    cnt = scur == ANY ? run(&*begin, n, set, negated) : run(&*begin, n, lit, negated);
+                    begin += cnt;
+                    if (begin != end)
+                        cur = *begin;
+                    return cnt >= min && cnt <= max;
+                }
+            }
+            while (cnt <= max && begin != end)
+            {
+                if (negated == (scur == ANY ? any(set, cur) : cur == lit))
+                    return cnt >= min;
+                if (++cnt, ++begin != end)
+                    cur = uchar(*begin);
             }
-            return (pos = new_pos, cnt >= min && cnt <= max);
+            return cnt >= min && cnt <= max;
         }
     } // namespace internal
 
+    /// @brief The character encoding of simplex expressions and their input, see simplex::parse().
+    enum class encoding : internal::uchar
+    {
+        /// @brief every byte is a character
+        bytes,
+        /// @brief expressions and input are UTF-8, negations "!" and any-groups "[]" match whole codepoints and their ranges are codepoint
+        /// ranges, a malformed sequence in the input is one character that is not a member of any group
+        utf8,
+    };
+
+    /// @brief Upper bound on the size of a parsed simplex expression.
+    /// @param size The size of the simplex expression.
+    /// @return constexpr size_t The minimum container size that can hold any parsed expression of that size.
+    /// @details Every character parses to at most two internal codes, a literal parses to a CHAR op code followed by the
+    /// literal, except any-groups "[]" which take at least two characters and parse to an ANY op code followed by a 256-bit
+    /// membership table, and runs of at least two literals which parse to a STRING op code and length followed by the literals.
+    constexpr size_t capacity(size_t size)
+    {
+        return 2 * size + (internal::any_size - 1) * (size / 2);
+    }
+
     /// @brief Parses a simplex expression and converts it to a string of internal codes.
     /// @tparam Iter Iterator type of the container.
     /// @param expr The simplex expression to parse.
     /// @param begin Iterator pointing to the beginning of the container.
     /// @param end Iterator pointing to the end of the container.
+    /// @param enc The encoding of the expression and of the input it is matched against.
     /// @return constexpr std::string_view The string of internal codes.
     /// @throws std::logic_error If the expression is too large for the container, or if there is a syntax error in the expression.
     /// @details This function converts a simplex expression to a string of internal codes that can be used by the Simplex engine.
     /// The function iterates through the expression and converts each character to its corresponding internal code.
     /// The resulting string of internal codes is returned as a std::string_view.
     /// If the expression is too large for the container, or if there is a syntax error in the expression, a std::logic_error is thrown.
+    /// In UTF-8 mode, groups with members above 0x7F and negated (or quantified non-ASCII) codepoints parse to UTF8 classes instead.
     template <typename Iter>
-    constexpr std::string_view parse(std::string_view expr, Iter begin, const Iter end)
+    constexpr std::string_view parse(std::string_view expr, Iter begin, const Iter end, const encoding enc = encoding::bytes)
     {
         static_assert(std::is_same<char, typename std::iterator_traits<Iter>::value_type>::value, "simplex::parse(): iterator::value_type must be char");
-        if (auto dist = std::distance(begin, end); 0 > dist || expr.size() > size_t(dist))
-            throw std::logic_error("simplex::parse(): expression too large for container");
         using namespace internal;
         size_t xi{0};
         uchar c{0};
-        Iter p = begin;
-        for (; xi < expr.size(); ++xi, ++p)
+        // an operator is waiting for its matching unit
+        bool dangling{false}, quantified{false}, negated{false};
+        // plain literals are fused into a STRING starting at run
+        uchar run_len{0};
+        Iter p = begin, run = begin;
+        auto emit = [&p, &end](uchar code)
+        {
+            if (p == end)
+                throw std::logic_error("simplex::parse(): expression too large for container");
+            *p = char(code), ++p;
+        };
+        auto next = [&expr, &xi](const char *error) -> uchar
+        { // advance to the next character of an unfinished operator or group
+            if (++xi >= expr.size())
+                throw std::logic_error(error);
+            return expr[xi];
+        };
+        auto unit = [&expr, &xi, &next](const char *error) -> uchar
+        { // read a possibly escaped character of a matching unit
+            return expr[xi] == '\\' ? next(error) : uchar(expr[xi]);
+        };
+        const bool utf8 = enc == encoding::utf8;
+        auto member = [&expr, &xi, &unit, utf8](const char *error) -> uint32_t
+        { // read a possibly escaped character of a matching unit, a whole codepoint in UTF-8 mode
+            uchar lead = unit(error);
+            if (!utf8 || lead < 0x80)
+                return lead;
+            const char *it = expr.data() + xi, *last = expr.data() + expr.size();
+            uint32_t cp = codepoint(it, last, lead);
+            if (cp >= malformed)
+                throw std::logic_error("simplex::parse(): malformed UTF-8 sequence");
+            xi = size_t(it - expr.data()) - 1;
+            return cp;
+        };
+        auto quantifier = [&emit, &quantified, &dangling, &run_len](uchar code)
+        {
+            if (quantified)
+                throw std::logic_error("simplex::parse(): malformed quantifier, nested quantifiers are not allowed");
+            emit(code);
+            quantified = dangling = true, run_len = 0;
+        };
+        for (; xi < expr.size(); ++xi)
         {
             c = expr[xi];
             switch (c)
             {
-            case '\\':
-                *p = expr[++xi];
-                break;
             case '!':
-                switch (c)
-                {
-                case '!':
-                    *p |= NOT;
-                    break;
-                }
-                for (c = expr[xi + 1];; c = expr[++xi + 1])
-                {
-                    switch (c)
-                    {
-                    case '!':
-                        *p |= NOT;
-                        continue;
-                    }
-                    break;
-                }
-                break;
+                run_len = 0;
+                while (xi + 1 < expr.size() && expr[xi + 1] == '!')
+                    ++xi;
+                // negated groups are folded into their membership table, as are negated codepoints in UTF-8 mode
+                if (xi + 1 < expr.size() && (expr[xi + 1] == '[' || (utf8 && std::string_view("*+?{").find(expr[xi + 1]) == std::string_view::npos)))
+                    negated = true;
+                else
+                    emit(NOT);
+                dangling = true;
+                continue;
             case '*':
-                *p = ZERO_OR_MORE;
-                break;
+                quantifier(ZERO_OR_MORE);
+                continue;
             case '+':
-                *p = ONE_OR_MORE;
-                break;
+                quantifier(ONE_OR_MORE);
+                continue;
             case '?':
-                *p = ZERO_OR_ONE;
-                break;
+                quantifier(ZERO_OR_ONE);
+                continue;
             case '{':
             {
-                *p = QUANTIFY;
-                uchar digits[3]{};
-                size_t i = 0;
-                for (c = expr[++xi]; i < 3 && c >= '0' && c <= '9'; ++i, c = expr[++xi])
-                    digits[i] = c;
+                quantifier(QUANTIFY);
+                constexpr const char *expected_comma = "simplex::parse(): malformed quantifier, exptected ','";
+                constexpr const char *expected_brace = "simplex::parse(): malformed quantifier, exptected '}'";
+                auto bound = [&](const char *error, uint64_t empty)
+                {
+                    uint64_t res{0};
+                    size_t i = 0;
+                    for (c = next(error); c >= '0' && c <= '9'; ++i, c = next(error))
+                    {
+                        if (res > (unbounded - 1 - uint64_t(c - '0')) / 10)
+                            throw std::logic_error("simplex::parse(): malformed quantifier, bound is too large");
+                        res = res * 10 + uint64_t(c - '0');
+                    }
+                    return i == 0 ? empty : res;
+                };
+                uint64_t min = bound(expected_comma, 0);
                 if (c != ',')
-                    throw std::logic_error("simplex::parse(): malformed quantifier, exptected ','");
-                *++p = (i == 0 ? uchar(0) : stouc(digits, i));
-                i = 0;
-                for (c = expr[++xi]; i < 3 && c >= '0' && c <= '9'; ++i, c = expr[++xi])
-                    digits[i] = c;
+                    throw std::logic_error(expected_comma);
+                uint64_t max = bound(expected_brace, unbounded);
                 if (c != '}')
-                    throw std::logic_error("simplex::parse(): malformed quantifier, exptected '}'");
-                *++p = (i == 0 ? uchar(SIMPLEX_QUANTIFY_INF) : stouc(digits, i));
+                    throw std::logic_error(expected_brace);
+                // bounds are varints of at most as many bytes as their digits, and the maximum is stored plus one so that unbounded is 0
+                put_varint(emit, min), put_varint(emit, max + 1);
                 continue;
             }
             case '[':
             {
-                *p = ANY;
-                Iter lp = ++p;
-                c = expr[++xi];
-                for (; c == '-'; c = expr[++xi])
+                char set[any_size]{};
+                constexpr const char *unterminated = "simplex::parse(): unterminated any group";
+                // in UTF-8 mode members above 0x7F are emitted as ranges as they are read, after a header whose table is written last
+                Iter head = p;
+                bool ranges{false};
+                if (utf8)
+                {
+                    emit(UTF8), emit(negated);
+                    for (size_t i = 0; i < any_size / 2; ++i)
+                        emit(0);
+                }
+                auto add = [&](uint32_t lo, uint32_t hi)
                 {
-                    *++p = RANGE;
-                    if (expr[++xi] == ']')
+                    for (uint32_t r = lo; r <= hi && (!utf8 || r < 0x80); ++r)
+                        any_set(set, uchar(r));
+                    if (utf8 && hi >= 0x80 && hi >= lo)
+                    {
+                        lo = std::max<uint32_t>(lo, 0x80);
+                        put_varint(emit, lo), put_varint(emit, hi - lo), ranges = true;
+                    }
+                };
+                for (c = next(unterminated); c == '-'; c = next(unterminated))
+                {
+                    if (next(unterminated) == ']')
                         throw std::logic_error("simplex::parse(): malformed range, ']' must be escaped within a range");
-                    *++p = expr[xi] == '\\' ? expr[++xi] : expr[xi];
-                    if (expr[++xi] == ']')
+                    uint32_t lo = member(unterminated);
+                    if (next(unterminated) == ']')
                         throw std::logic_error("simplex::parse(): malformed range, ']' must be escaped within a range");
-                    *++p = expr[xi] == '\\' ? expr[++xi] : expr[xi];
+                    add(lo, member(unterminated));
                 }
-                for (; c != ']'; c = expr[++xi])
+                for (; c != ']'; c = next(unterminated))
                 {
-                    *++p = expr[xi] == '\\' ? expr[++xi] : expr[xi];
+                    uint32_t cp = member(unterminated);
+                    add(cp, cp);
                 }
-                auto dist = std::distance(lp, p);
-                if (255 < dist || 0 > dist)
-                    throw std::logic_error("simplex::parse(): malformed any range, range must be 0 to 255 characters");
-                *lp = uchar(dist); // store length of any group, max 255
-                continue;
+                run_len = 0;
+                if (utf8 && (ranges || negated))
+                {
+                    emit(0);
+                    Iter it = std::next(head, 2);
+                    for (size_t i = 0; i < any_size / 2; ++i, ++it)
+                        *it = char(negated ? ~set[i] : set[i]);
+                }
+                else
+                { // only ASCII members, which match the same as bytes
+                    p = head;
+                    emit(ANY);
+                    for (size_t i = 0; i < any_size; ++i)
+                        emit(uchar(negated ? ~set[i] : set[i]));
+                }
+                break;
             }
             default:
-                *p = c;
-                continue;
+            {
+                uint32_t cp = member("simplex::parse(): unterminated escape sequence");
+                if (utf8 && dangling && (negated || cp >= 0x80))
+                { // a negated or quantified codepoint is a class of one
+                    char set[any_size]{};
+                    if (cp < 0x80)
+                        any_set(set, uchar(cp));
+                    emit(UTF8), emit(negated);
+                    for (size_t i = 0; i < any_size / 2; ++i)
+                        emit(uchar(negated ? ~set[i] : set[i]));
+                    if (cp >= 0x80)
+                        put_varint(emit, cp), put_varint(emit, 0);
+                    emit(0), run_len = 0;
+                    break;
+                }
+                // otherwise the bytes of a codepoint are plain literals
+                size_t width = cp < 0x80 || !utf8 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+                for (size_t i = xi + 1 - width; i <= xi; ++i)
+                {
+                    uchar lit = uchar(expr[i]);
+                    if (dangling || run_len == 0 || run_len == 0xFF)
+                    { // start a new run with a single literal
+                        run = p, run_len = dangling ? 0 : 1;
+                        emit(CHAR), emit(lit);
+                    }
+                    else if (run_len == 1)
+                    { // promote the single literal to a STRING
+                        uchar prev = *std::next(run);
+                        *run = char(STRING), run_len = 2;
+                        *std::next(run) = char(run_len);
+                        emit(prev), emit(lit);
+                    }
+                    else
+                    {
+                        *std::next(run) = char(++run_len);
+                        emit(lit);
+                    }
+                }
+                break;
+            }
             }
+            dangling = quantified = negated = false;
         }
-        auto len = std::distance(begin, p);
-        bool unterminated_quantify = len > 3 && uchar(*(p - 3)) == QUANTIFY;
-        bool unterminated_flag = len > 1 && uchar(*(p - 1)) == NOT;
-        if (unterminated_quantify || unterminated_flag)
+        if (dangling)
             throw std::logic_error("simplex::parse(): unterminated simplex operator");
-        return std::string_view(&(*begin), size_t(len));
+        return std::string_view(&(*begin), size_t(std::distance(begin, p)));
     }
 
-    /// @brief Matches a parsed simplex expression with a range of iterators.
+    namespace internal
+    {
+        /// @brief a matching unit of a parsed simplex expression with its flags and quantifier, see simplex::optimize()
+        struct decoded
+        {
+            /// @brief NOT flag before the unit, inverting the result of its quantifier if quantified
+            bool inverted{false};
+            bool quantified{false};
+            /// @brief NOT flag between the quantifier and its unit
+            bool negated{false};
+            uint64_t min{1}, max{1};
+            /// @brief offset of the unit's code
+            size_t at{0};
+            /// @brief offset of the next matching unit
+            size_t next{0};
+        };
+
+        constexpr decoded decode(std::string_view code, size_t pos)
+        {
+            decoded u;
+            for (; uchar(code[pos]) == NOT; ++pos)
+                u.inverted = true;
+            u.quantified = quantifier(code, pos, u.min, u.max);
+            if (u.quantified && uchar(code[pos]) == NOT)
+                u.negated = true, ++pos;
+            u.at = pos, u.next = pos + unit_size(code, pos);
+            return u;
+        }
+
+        /// @brief the membership table of the characters a unit accepts (the first character of a STRING, the first bytes of a UTF8 class)
+        constexpr void unit_set(std::string_view code, size_t at, bool negated, char (&set)[any_size])
+        {
+            const uchar op = uchar(code[at]);
+            if (op == UTF8)
+            { // any byte above 0x7F may begin a codepoint of a class with members above 0x7F, or its negation
+                bool wide = negated || code[at + 1] != '\0' || code[at + 2 + any_size / 2] != '\0';
+                for (size_t i = 0; i < any_size; ++i)
+                    set[i] = negated ? char(0xFF) : i < any_size / 2 ? code[at + 2 + i] : char(wide ? 0xFF : 0);
+                return;
+            }
+            for (size_t i = 0; i < any_size; ++i)
+                set[i] = op == ANY ? code[at + 1 + i] : char(0);
+            if (op != ANY)
+                any_set(set, uchar(code[at + (op == STRING ? 2 : 1)]));
+            for (size_t i = 0; negated && i < any_size; ++i)
+                set[i] = char(~set[i]);
+        }
+
+        /// @brief check if the remainder of a program from pos fails at the end of the input and on every character of set
+        constexpr bool requires_outside(std::string_view code, size_t pos, const char (&set)[any_size])
+        {
+            if (pos >= code.size())
+                return false;
+            decoded u = decode(code, pos);
+            if (u.quantified && (u.inverted || u.min == 0))
+                return false;
+            char first[any_size]{};
+            unit_set(code, u.at, u.quantified ? u.negated : u.inverted, first);
+            for (size_t i = 0; i < any_size; ++i)
+            {
+                if ((first[i] & set[i]) != 0)
+                    return false;
+            }
+            return true;
+        }
+
+        /// @brief size of an emitted quantifier, in its shortest form
+        constexpr size_t quantifier_size(uint64_t min, uint64_t max)
+        {
+            return (min <= 1 && max == unbounded) || (min == 0 && max == 1) ? 1 : bounds_size(min, max);
+        }
+    } // namespace internal
+
+    /// @brief Simplifies a parsed simplex expression in place, without changing what it matches.
     /// @tparam Iter The type of the iterator.
-    /// @param expr The parsed simplex expression to match.
-    /// @param begin The beginning of the range of iterators.
-    /// @param end The end of the range of iterators.
-    /// @return true If the expression matches the range of iterators.
-    /// @return false If the expression does not match the range of iterators.
+    /// @param begin The beginning of the parsed expression, see simplex::parse().
+    /// @param end The end of the parsed expression.
+    /// @return std::string_view The optimized expression, at the beginning of [begin, end).
+    /// @details Since quantifiers are greedy and fail on one character past their maximum, a unit is only removed or merged where the
+    /// units after it guarantee the same result:
+    /// - "{0,}", "{1,}" and "{0,1}" use their one byte op codes, and groups with one member (or all but one) become literals
+    /// - NOT flags on groups are folded into their membership table
+    /// - "{0,0}x" is dropped, and "{1,1}x" unwrapped, when the next unit requires a character other than x
+    /// - "{0,n}x" is dropped after a quantified x, whose run it cannot continue, when the next unit requires a character
+    /// - a literal (or group) before its own quantifier is counted by the quantifier, e.g. "a{2,5}a" becomes "{3,6}a"
+    /// - UTF8 classes and runs of literals are kept as they are
     template <typename Iter>
-    bool matches(std::string_view expr, Iter begin, const Iter end)
+    constexpr std::string_view optimize(Iter begin, const Iter end)
     {
         using namespace internal;
-        static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && std::is_same<char, typename std::iterator_traits<Iter>::value_type>::value, "simplex::match() iterator must be a forward iterator over chars");
-        size_t pos{0};
-        uint16_t min, max;
-        uchar cur, scur, any_len, flags{0};
-        bool res;
-        for (; pos < expr.size() && begin != end; ++pos)
+        char *code = &*begin;
+        const size_t size = size_t(std::distance(begin, end));
+        const char none[any_size]{};
+        // units are rewritten in place and never grow, so the unit being read is always at or after the write position
+        size_t r{0}, w{0}, prev{std::string_view::npos};
+        while (r < size)
         {
-            cur = *begin, scur = expr[pos];
-            switch (scur)
+            const std::string_view in(code, size);
+            const decoded u = decode(in, r);
+            uchar op = uchar(in[u.at]), lit = op == CHAR ? uchar(in[u.at + 1]) : uchar(0);
+            if (op == STRING || op == UTF8)
             {
-            case NOT:
-                // flags only set the next matching unit
-                flags |= scur & uchar(0x7F);
+                for (size_t i = r; i < u.next; ++i)
+                    code[w + i - r] = code[i];
+                prev = w, w += u.next - r, r = u.next;
                 continue;
-            case QUANTIFY:
-                min = expr[++pos], max = expr[++pos];
-                res = quantify<Iter>(expr, begin, end, pos, cur, min, max == SIMPLEX_QUANTIFY_INF ? SIMPLEX_INF : max);
-                break;
-            case ZERO_OR_MORE:
-                res = quantify<Iter>(expr, begin, end, pos, cur, 0, SIMPLEX_INF);
-                break;
-            case ONE_OR_MORE:
-                res = quantify<Iter>(expr, begin, end, pos, cur, 1, SIMPLEX_INF);
-                break;
-            case ZERO_OR_ONE:
-                res = quantify<Iter>(expr, begin, end, pos, cur, 0, 1);
-                break;
-            case ANY:
-                any_len = expr[pos + 1];
-                res = any(expr.substr(pos + 2, any_len), cur);
-                pos += any_len + 1, ++begin;
-                break;
-            default:
-                res = cur == scur, ++begin;
-                break;
             }
-            if (!(test_flag(flags, NOT) ^ res))
-                return false;
-            flags = 0;
+            bool quantified = u.quantified, inverted = u.quantified && u.inverted, negated = u.quantified ? u.negated : u.inverted;
+            uint64_t min = u.min, max = u.max;
+            char set[any_size]{};
+            unit_set(in, u.at, negated, set);
+            if (op == ANY)
+            { // fold the NOT flag into the table, and replace groups of one (or all but one) characters with literals
+                negated = false;
+                unsigned members{0};
+                uchar member{0}, missing{0};
+                for (unsigned c = 0; c < any_size * 8; ++c)
+                    any(std::string_view(set, any_size), uchar(c)) ? (++members, member = uchar(c)) : (missing = uchar(c));
+                if (members == 1)
+                    op = CHAR, lit = member;
+                else if (members == any_size * 8 - 1)
+                    op = CHAR, lit = missing, negated = true;
+            }
+            if (quantified && !inverted)
+            {
+                if (max == 0 && requires_outside(in, u.next, set))
+                { // can only fail on a character the next unit fails on as well
+                    r = u.next;
+                    continue;
+                }
+                if (min == 1 && max == 1 && requires_outside(in, u.next, set))
+                    quantified = false;
+                else if (min == 0 && prev != std::string_view::npos && requires_outside(in, u.next, none))
+                { // the previous run stopped on a character outside of it, so outside of this subset of it
+                    const decoded p = decode(std::string_view(code, w), prev);
+                    char outer[any_size]{};
+                    unit_set(std::string_view(code, w), p.at, p.negated, outer);
+                    bool subset{p.quantified && !p.inverted && uchar(code[p.at]) != UTF8};
+                    for (size_t i = 0; subset && i < any_size; ++i)
+                        subset = (set[i] & ~outer[i]) == 0;
+                    if (subset)
+                    {
+                        r = u.next;
+                        continue;
+                    }
+                }
+            }
+            size_t unit = op == ANY ? any_size + 1 : 2;
+            // count the same unit right before the quantifier as part of its run
+            while (quantified && !inverted && max != unbounded - 1 && (min != 0 || requires_outside(in, u.next, none)) && prev != std::string_view::npos)
+            {
+                const std::string_view out(code, w);
+                const decoded p = decode(out, prev);
+                if (p.quantified)
+                    break;
+                bool literal = uchar(out[p.at]) == STRING;
+                size_t popped = literal ? (uchar(out[p.at + 1]) > 2 ? w - 1 : p.at + 2) : prev;
+                if (popped + negated + quantifier_size(min + 1, max == unbounded ? max : max + 1) + unit > u.next)
+                    break; // the merged unit would overwrite the next unit before it is read
+                if (literal)
+                { // drop the last literal of the STRING, a STRING of two becomes a literal
+                    if (op != CHAR || negated || uchar(out[w - 1]) != lit)
+                        break;
+                    if (uchar(out[p.at + 1]) > 2)
+                        code[p.at + 1] = char(uchar(out[p.at + 1]) - 1);
+                    else
+                        code[p.at] = char(CHAR), code[p.at + 1] = out[p.at + 2];
+                }
+                else
+                {
+                    bool same = uchar(out[p.at]) == op && p.inverted == negated && (op != CHAR || uchar(out[p.at + 1]) == lit);
+                    for (size_t i = 0; same && op == ANY && i < any_size; ++i)
+                        same = out[p.at + 1 + i] == set[i];
+                    if (!same)
+                        break;
+                    prev = std::string_view::npos;
+                }
+                w = popped, ++min, max += max != unbounded;
+            }
+            const size_t start = w;
+            if (inverted)
+                code[w++] = char(NOT);
+            if (quantified)
+            {
+                if (min == 0 && max == unbounded)
+                    code[w++] = char(ZERO_OR_MORE);
+                else if (min == 1 && max == unbounded)
+                    code[w++] = char(ONE_OR_MORE);
+                else if (min == 0 && max == 1)
+                    code[w++] = char(ZERO_OR_ONE);
+                else
+                {
+                    auto out = [&code, &w](uchar byte)
+                    { code[w++] = char(byte); };
+                    code[w++] = char(QUANTIFY), put_varint(out, min), put_varint(out, max + 1);
+                }
+            }
+            if (negated)
+                code[w++] = char(NOT);
+            code[w++] = char(op);
+            if (op == CHAR)
+                code[w++] = char(lit);
+            for (size_t i = 0; op == ANY && i < any_size; ++i)
+                code[w++] = set[i];
+            prev = start, r = u.next;
         }
-        // we reached the end of the expression, we do not check for any remaining input
-        return pos == expr.size();
+        return std::string_view(code, w);
+    }
+
+    namespace internal
+    {
+        /// @brief match a run of literal characters at the beginning of a range of iterators, advancing past them if they match
+        /// @param cur the character at begin, already read
+        template <typename Iter>
+        constexpr bool string(std::string_view str, Iter &begin, const Iter &end, uchar cur)
+        {
+            if constexpr (is_char_pointer<Iter>)
+            { // a single length check and a wide compare
+                if (size_t(end - begin) < str.size() || std::char_traits<char>::compare(&*begin, str.data(), str.size()) != 0)
+                    return false;
+                begin += str.size();
+                return true;
+            }
+            else
+            {
+                for (size_t i = 0; i < str.size(); ++i, ++begin)
+                {
+                    if (begin == end || (i == 0 ? cur : uchar(*begin)) != uchar(str[i]))
+                        return false;
+                }
+                return true;
+            }
+        }
+
+        /// @brief match a parsed simplex expression at the beginning of a range of iterators
+        /// @param begin the beginning of the range, advanced past the consumed input
+        /// @return true if the expression matches
+        template <typename Iter>
+        constexpr bool consume(std::string_view expr, Iter &begin, const Iter &end)
+        {
+            size_t pos{0};
+            uint64_t min{0}, max{0};
+            uchar cur{0}, scur{0}, flags{0};
+            // cur already holds *begin, single-pass iterators are only read once per character
+            bool res{false}, read{false};
+            for (; pos < expr.size() && begin != end; ++pos)
+            {
+                if (!read)
+                    cur = uchar(*begin), read = true;
+                scur = expr[pos];
+                switch (scur)
+                {
+                case NOT:
+                    // flags only set the next matching unit
+                    flags |= scur & uchar(0x7F);
+                    continue;
+                case QUANTIFY:
+                case ZERO_OR_MORE:
+                case ONE_OR_MORE:
+                case ZERO_OR_ONE:
+                    quantifier(expr, pos, min, max);
+                    res = quantify<Iter>(expr, begin, end, pos, cur, min, max);
+                    break;
+                case ANY:
+                    res = any(expr.substr(pos + 1, any_size), cur);
+                    pos += any_size, ++begin, read = false;
+                    break;
+                case STRING:
+                    res = string(expr.substr(pos + 2, uchar(expr[pos + 1])), begin, end, cur);
+                    pos += uchar(expr[pos + 1]) + 1, read = false;
+                    break;
+                case CHAR:
+                    res = cur == uchar(expr[++pos]), ++begin, read = false;
+                    break;
+                case UTF8: // cur holds the character after the codepoint
+                    res = utf8_member(expr, pos, codepoint(begin, end, cur));
+                    pos += unit_size(expr, pos) - 1;
+                    break;
+                default:
+                    throw std::logic_error("simplex::matches(): malformed expression, unknown op code");
+                }
+                if (!(test_flag(flags, NOT) ^ res))
+                    return false;
+                flags = 0;
+            }
+            // we reached the end of the expression, we do not check for any remaining input
+            return pos == expr.size();
+        }
+
+        /// @brief the set of characters that may begin a match of a parsed simplex expression, used to skip ahead when searching
+        struct prefilter
+        {
+            /// @brief 256-bit membership table of the characters that may begin a match
+            char set[any_size]{};
+            /// @brief number of characters in set, any_size * 8 if every character may begin a match
+            uint16_t count{0};
+            /// @brief the only member of set, if count == 1
+            uchar first{0};
+
+            constexpr prefilter(std::string_view expr)
+            {
+                size_t pos{0};
+                bool complete{false};
+                while (!complete && pos < expr.size())
+                {
+                    bool negated{false};
+                    uint64_t min{1}, max{1};
+                    if (uchar(expr[pos]) == NOT)
+                        negated = true, ++pos;
+                    else
+                        quantifier(expr, pos, min, max);
+                    if (pos >= expr.size())
+                        break;
+                    uchar scur = expr[pos];
+                    if (scur == NOT)
+                    {
+                        negated = !negated, scur = expr[++pos];
+                    }
+                    if ((scur != ANY && scur != STRING && scur != CHAR && scur != UTF8) || (scur == UTF8 && negated))
+                        break; // a negated quantifier, its result does not depend on the next character alone
+                    // a STRING is never quantified, so the match begins with its first literal
+                    uchar lit = scur == STRING || scur == CHAR ? uchar(expr[pos + (scur == STRING ? 2 : 1)]) : uchar(0);
+                    // a UTF8 class with members above 0x7F, or negated ranges, may begin with any byte above 0x7F
+                    bool wide = scur == UTF8 && (expr[pos + 1] != '\0' || expr[pos + 2 + any_size / 2] != '\0');
+                    for (unsigned c = 0; c < any_size * 8; ++c)
+                    {
+                        bool res = scur == ANY ? any(expr.substr(pos + 1, any_size), uchar(c)) : scur == UTF8 ? (c < 0x80 ? any(expr.substr(pos + 2, any_size / 2), uchar(c)) : wide) : c == lit;
+                        if (negated ^ res)
+                            any_set(set, uchar(c));
+                    }
+                    pos += unit_size(expr, pos);
+                    // optional units may be skipped, so the next unit may begin the match as well
+                    complete = min != 0;
+                }
+                if (!complete)
+                {
+                    for (auto &c : set)
+                        c = char(0xFF);
+                }
+                for (unsigned c = 0; c < any_size * 8; ++c)
+                {
+                    if (any(std::string_view(set, any_size), uchar(c)))
+                        ++count, first = uchar(c);
+                }
+            }
+
+            /// @brief check if a character may begin a match
+            constexpr bool contains(const uchar cur) const { return any(std::string_view(set, any_size), cur); }
+
+            /// @brief skip ahead to the first character in [begin, end) that may begin a match
+            constexpr const char *skip(const char *begin, const char *end) const
+            {
+                if (count == any_size * 8)
+                    return begin;
+                if (count == 1)
+                {
+                    const char *found = std::char_traits<char>::find(begin, size_t(end - begin), char(first));
+                    return found ? found : end;
+                }
+                if (!SIMPLEX_CONSTANT_EVALUATED())
+                    return begin + run(begin, size_t(end - begin), std::string_view(set, any_size), true);
+                while (begin != end && !contains(uchar(*begin)))
+                    ++begin;
+                return begin;
+            }
+        };
+
+        /// @brief "simplex" and a NUL, the first bytes of a serialized image, see SimplexDatabase
+        constexpr char image_magic[8] = {'s', 'i', 'm', 'p', 'l', 'e', 'x', '\0'};
+        /// @brief version of the serialized image layout, and of the parsed program format it holds
+        constexpr uint32_t image_version = 1;
+
+        /// @brief header of a serialized image, followed by count records and the parsed expressions
+        struct alignas(8) image_header
+        {
+            char magic[8];
+            uint32_t version;
+            /// @brief sizeof(image_record), so images with a different record layout are rejected
+            uint32_t record_size;
+            uint64_t count;
+            /// @brief size of the whole image in bytes
+            uint64_t size;
+        };
+
+        /// @brief index entry of an expression in a serialized image
+        struct alignas(8) image_record
+        {
+            /// @brief offset of the parsed expression from the beginning of the image
+            uint64_t offset;
+            uint64_t size;
+            prefilter filter;
+        };
+
+        static_assert(sizeof(image_header) == 32 && sizeof(image_record) == 56 && alignof(image_record) == 8, "simplex image layout must not depend on the compiler");
+    } // namespace internal
+
+    /// @brief Matches a parsed simplex expression with a range of iterators.
+    /// @tparam Iter The type of the iterator.
+    /// @param expr The parsed simplex expression to match.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the range of iterators.
+    /// @return true If the expression matches the range of iterators.
+    /// @return false If the expression does not match the range of iterators.
+    /// @details Single-pass input iterators (e.g. std::istreambuf_iterator) are supported, every character is read once and never past the end.
+    /// A quantified class of a UTF-8 expression (see simplex::encoding::utf8) only knows a codepoint is not a member after reading all of
+    /// its bytes, which the next unit would have to read again, so matching one with single-pass iterators throws std::logic_error.
+    template <typename Iter>
+    constexpr bool matches(std::string_view expr, Iter begin, const Iter end)
+    {
+        static_assert(std::is_base_of<std::input_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && internal::is_byte<typename std::iterator_traits<Iter>::value_type>, "simplex::matches() iterator must be an input iterator over bytes");
+        if constexpr (internal::is_byte_pointer<Iter>)
+        {
+            if (!SIMPLEX_CONSTANT_EVALUATED())
+            { // the same match as over chars, with the SIMD kernels
+                const char *it = internal::chars(begin);
+                return internal::consume(expr, it, internal::chars(end));
+            }
+        }
+        return internal::consume(expr, begin, end);
     }
 
     /// @brief Matches a parsed simplex expression with a string_view.
@@ -296,10 +1166,1055 @@ namespace simplex
     /// @param input The string_view to match against.
     /// @return true If the expression matches the input.
     /// @return false If the expression does not match the input.
-    bool matches(std::string_view expr, std::string_view input)
+    constexpr bool matches(std::string_view expr, std::string_view input)
+    {
+        return matches<const char *>(expr, input.data(), input.data() + input.size());
+    }
+
+    /// @brief Value returned by simplex::match() and simplex::search() when there is no match.
+    constexpr size_t npos = std::string_view::npos;
+
+    /// @brief Matches a parsed simplex expression with a range of iterators, and returns where the match ended.
+    /// @tparam Iter The type of the iterator.
+    /// @param expr The parsed simplex expression to match.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the range of iterators.
+    /// @return std::optional<Iter> The iterator past the last character consumed by the match, or std::nullopt if the expression does not match.
+    /// @throws std::logic_error If a quantified UTF-8 class is matched with single-pass iterators, see simplex::matches().
+    template <typename Iter>
+    constexpr std::optional<Iter> match(std::string_view expr, Iter begin, const Iter end)
+    {
+        static_assert(std::is_base_of<std::input_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && internal::is_byte<typename std::iterator_traits<Iter>::value_type>, "simplex::match() iterator must be an input iterator over bytes");
+        if constexpr (internal::is_byte_pointer<Iter>)
+        {
+            if (!SIMPLEX_CONSTANT_EVALUATED())
+            {
+                const char *it = internal::chars(begin);
+                if (internal::consume(expr, it, internal::chars(end)))
+                    return begin + (it - internal::chars(begin));
+                return std::nullopt;
+            }
+        }
+        if (internal::consume(expr, begin, end))
+            return begin;
+        return std::nullopt;
+    }
+
+    /// @brief Matches a parsed simplex expression with a string_view, and returns the length of the match.
+    /// @param expr The parsed simplex expression to match.
+    /// @param input The string_view to match against.
+    /// @return size_t The number of characters consumed by the match, or simplex::npos if the expression does not match.
+    constexpr size_t match(std::string_view expr, std::string_view input)
+    {
+        const char *it = input.data();
+        return internal::consume(expr, it, input.data() + input.size()) ? size_t(it - input.data()) : npos;
+    }
+
+    /// @brief Matches a parsed simplex expression with an entire range of iterators.
+    /// @tparam Iter The type of the iterator.
+    /// @param expr The parsed simplex expression to match.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the range of iterators.
+    /// @return true If the expression matches and consumes the entire range.
+    /// @return false Otherwise.
+    /// @throws std::logic_error If a quantified UTF-8 class is matched with single-pass iterators, see simplex::matches().
+    template <typename Iter>
+    constexpr bool full_match(std::string_view expr, Iter begin, const Iter end)
+    {
+        static_assert(std::is_base_of<std::input_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && internal::is_byte<typename std::iterator_traits<Iter>::value_type>, "simplex::full_match() iterator must be an input iterator over bytes");
+        if constexpr (internal::is_byte_pointer<Iter>)
+        {
+            if (!SIMPLEX_CONSTANT_EVALUATED())
+            {
+                const char *it = internal::chars(begin), *last = internal::chars(end);
+                return internal::consume(expr, it, last) && it == last;
+            }
+        }
+        return internal::consume(expr, begin, end) && begin == end;
+    }
+
+    /// @brief Matches a parsed simplex expression with an entire string_view.
+    /// @param expr The parsed simplex expression to match.
+    /// @param input The string_view to match against.
+    /// @return true If the expression matches and consumes the entire input.
+    /// @return false Otherwise.
+    constexpr bool full_match(std::string_view expr, std::string_view input)
+    {
+        return match(expr, input) == input.size();
+    }
+
+    /// @brief The state of an incremental match, see simplex::stream_matcher.
+    enum class status : internal::uchar
+    {
+        /// @brief the input does not match
+        no_match,
+        /// @brief the input matches, any further input is not examined
+        match,
+        /// @brief the input matches so far, but the match is not decided yet
+        need_more,
+    };
+
+    /// @brief Matches a parsed simplex expression against input arriving in successive chunks, without buffering it.
+    /// @details The position in the expression, the count of the current quantifier (or the matched length of the current
+    /// run of literals) is kept between chunks, so every character is examined once. The result is the same as simplex::matches()
+    /// on the concatenated chunks, and is reported as soon as it is decided.
+    class stream_matcher
+    {
+        std::string_view code;
+        /// @brief offset of the current matching unit, including its NOT flag and quantifier
+        size_t pos{0};
+        /// @brief characters consumed by the match so far
+        size_t len{0};
+        /// @brief characters matched by the current quantifier, or of the current run of literals
+        uint64_t cnt{0};
+        status result;
+        /// @brief the bytes of a UTF-8 sequence cut off by the end of the previous chunk
+        char pending[3]{};
+        internal::uchar npending{0};
+        /// @brief the input has ended, so a cut off sequence is malformed
+        bool eof{false};
+
+        /// @brief a decoded matching unit and its code
+        struct unit : internal::decoded
+        {
+            internal::uchar scur{0};
+            /// @brief the literal of a CHAR
+            internal::uchar lit{0};
+        };
+
+        constexpr unit decode() const
+        {
+            unit u;
+            static_cast<internal::decoded &>(u) = internal::decode(code, pos);
+            u.scur = internal::uchar(code[u.at]);
+            u.lit = u.scur == internal::CHAR ? internal::uchar(code[u.at + 1]) : internal::uchar(0);
+            if (u.quantified && u.scur >= internal::NOT && u.scur < internal::ANY)
+                throw std::logic_error("simplex::stream_matcher::feed(): malformed quantifier, nested quantifiers are not allowed");
+            return u;
+        }
+
+        /// @brief check if a character matches the code of a decoded unit, ignoring its flags
+        static constexpr bool test(const unit &u, std::string_view set, internal::uchar cur)
+        {
+            return u.scur == internal::ANY ? internal::any(set, cur) : cur == u.lit;
+        }
+
+        /// @brief the number of characters at the beginning of [p, p + n) in a quantified unit
+        static constexpr size_t span(const unit &u, std::string_view set, const char *p, size_t n)
+        {
+            if (!SIMPLEX_CONSTANT_EVALUATED())
+                return u.scur == internal::ANY ? internal::run(p, n, set, u.negated) : internal::run(p, n, u.lit, u.negated);
+            size_t i{0};
+            for (; i < n && u.negated != test(u, set, internal::uchar(p[i])); ++i)
+                ;
+            return i;
+        }
+
+        /// @brief keep the rest of a chunk for the next chunk if it is a UTF-8 sequence cut off by its end, advancing begin to end
+        /// @return true if the rest was kept
+        template <typename Iter>
+        constexpr bool stash(Iter &begin, const Iter &end)
+        {
+            Iter at = begin;
+            internal::uchar cur = internal::uchar(*at);
+            if (eof || internal::codepoint(at, end, cur) != internal::truncated)
+                return false;
+            for (; begin != end; ++begin)
+                pending[npending++] = char(*begin);
+            return true;
+        }
+
+        /// @brief finish the current matching unit with its result
+        constexpr void advance(const unit &u, bool res)
+        {
+            if (u.inverted == res)
+            {
+                result = status::no_match;
+                return;
+            }
+            pos = u.next, cnt = 0;
+            if (pos == code.size())
+                result = status::match;
+        }
+
+    public:
+        /// @brief Construct a stream_matcher for a parsed simplex expression.
+        /// @param expr The parsed simplex expression to match, which must outlive the stream_matcher.
+        constexpr explicit stream_matcher(std::string_view expr) : code(expr), result(expr.empty() ? status::match : status::need_more) {}
+
+        /// @brief Match the next chunk of input.
+        /// @tparam Iter The type of the iterator.
+        /// @param begin The beginning of the characters following the previous chunks.
+        /// @param end The end of the chunk.
+        /// @return status The state of the match, once decided the remaining input is ignored.
+        template <typename Iter>
+        constexpr status feed(Iter begin, const Iter end)
+        {
+            if constexpr (internal::is_byte_pointer<Iter>)
+            {
+                if (!SIMPLEX_CONSTANT_EVALUATED())
+                    return feed<const char *>(internal::chars(begin), internal::chars(end));
+            }
+            while (npending != 0 && result == status::need_more && begin != end)
+            { // complete the sequence cut off by the previous chunk, and match it (with the byte breaking it, if any) on its own
+                char seq[sizeof(pending) + 1]{};
+                size_t n = npending;
+                for (size_t i = 0; i < n; ++i)
+                    seq[i] = pending[i];
+                for (npending = 0;;)
+                {
+                    const char *at = seq;
+                    internal::uchar cur = internal::uchar(seq[0]);
+                    if (internal::codepoint(at, static_cast<const char *>(seq + n), cur) != internal::truncated)
+                        break;
+                    if (begin == end)
+                    {
+                        for (size_t i = 0; i < n; ++i)
+                            pending[npending++] = seq[i];
+                        return result;
+                    }
+                    seq[n++] = char(*begin), ++begin;
+                }
+                feed<const char *>(seq, seq + n);
+            }
+            while (result == status::need_more && begin != end)
+            {
+                const unit u = decode();
+                std::string_view set = u.scur == internal::ANY ? code.substr(u.at + 1, internal::any_size) : std::string_view();
+                bool res{false};
+                if (u.quantified)
+                { // consume up to one past max, stopping at the first character that does not match
+                    uint64_t limit = u.max == internal::unbounded ? internal::unbounded : u.max + 1 - cnt, k{0};
+                    if (u.scur == internal::UTF8)
+                    { // count codepoints, a codepoint cut off by the end of the chunk is counted with the next chunk
+                        Iter from = begin;
+                        k = internal::utf8_run(code, u.at, begin, end, u.negated, limit, eof);
+                        len += size_t(std::distance(from, begin));
+                        if (k < limit && begin != end)
+                            stash(begin, end);
+                    }
+                    else
+                    {
+                        if constexpr (internal::is_char_pointer<Iter>)
+                            k = span(u, set, &*begin, size_t(std::min<uint64_t>(uint64_t(end - begin), limit))), begin += k;
+                        else
+                        {
+                            for (; k < limit && begin != end && u.negated != test(u, set, internal::uchar(*begin)); ++k)
+                                ++begin;
+                        }
+                        len += k;
+                    }
+                    cnt += k;
+                    if (begin == end && k < limit)
+                        break; // the chunk ended within the run, more input may still match
+                    res = cnt >= u.min && cnt <= u.max;
+                }
+                else if (u.scur == internal::STRING)
+                {
+                    std::string_view str = code.substr(u.at + 2 + cnt, internal::uchar(code[u.at + 1]) - cnt);
+                    size_t n{0};
+                    if constexpr (internal::is_char_pointer<Iter>)
+                    {
+                        n = std::min(size_t(end - begin), str.size());
+                        if (std::char_traits<char>::compare(&*begin, str.data(), n) != 0)
+                            return result = status::no_match;
+                        begin += n;
+                    }
+                    else
+                    {
+                        for (; n < str.size() && begin != end; ++n, ++begin)
+                        {
+                            if (internal::uchar(*begin) != internal::uchar(str[n]))
+                                return result = status::no_match;
+                        }
+                    }
+                    len += n, cnt += n;
+                    if (n < str.size())
+                        break;
+                    res = true;
+                }
+                else if (u.scur == internal::UTF8)
+                {
+                    if (stash(begin, end))
+                        break;
+                    Iter from = begin;
+                    internal::uchar cur = internal::uchar(*begin);
+                    res = internal::utf8_member(code, u.at, internal::codepoint(begin, end, cur));
+                    len += size_t(std::distance(from, begin));
+                }
+                else
+                {
+                    res = test(u, set, internal::uchar(*begin));
+                    ++begin, ++len;
+                }
+                advance(u, res);
+            }
+            return result;
+        }
+
+        /// @brief Match the next chunk of input.
+        /// @param chunk The characters following the previous chunks.
+        /// @return status The state of the match, once decided the remaining input is ignored.
+        constexpr status feed(std::string_view chunk)
+        {
+            return feed<const char *>(chunk.data(), chunk.data() + chunk.size());
+        }
+
+        /// @brief Signal the end of the input.
+        /// @return status The final result of the match, either simplex::status::match or simplex::status::no_match.
+        /// @details A quantifier interrupted by the end of the input is decided by its count, as in simplex::matches().
+        constexpr status finish()
+        {
+            if (npending != 0 && result == status::need_more)
+            { // the input ended within a sequence, which is malformed
+                char seq[sizeof(pending)]{};
+                size_t n = npending;
+                for (size_t i = 0; i < n; ++i)
+                    seq[i] = pending[i];
+                eof = true, npending = 0;
+                feed<const char *>(seq, seq + n);
+            }
+            if (result == status::need_more && cnt != 0)
+            {
+                const unit u = decode();
+                if (u.quantified)
+                    advance(u, cnt >= u.min && cnt <= u.max);
+            }
+            if (result == status::need_more)
+                result = status::no_match;
+            return result;
+        }
+
+        /// @brief Restart matching from the beginning of the expression.
+        constexpr void reset() { *this = stream_matcher(code); }
+
+        /// @brief The state of the match.
+        constexpr status state() const { return result; }
+
+        /// @brief The number of characters consumed by the match so far, i.e. where a decided match ended.
+        constexpr size_t consumed() const { return len; }
+    };
+
+    /// @brief Matches a parsed simplex expression with the beginning of an input that may be incomplete.
+    /// @tparam Iter The type of the iterator.
+    /// @param expr The parsed simplex expression to match.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the input received so far.
+    /// @return status simplex::status::need_more if the input ran out before the match was decided, e.g. "GET /" for "GET /api/",
+    /// otherwise whether it matches as in simplex::matches().
+    /// @details Unlike simplex::matches(), a quantifier reaching the end of the input is undecided, since more input may exceed its maximum.
+    template <typename Iter>
+    constexpr status partial_match(std::string_view expr, Iter begin, const Iter end)
+    {
+        static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && internal::is_byte<typename std::iterator_traits<Iter>::value_type>, "simplex::partial_match() iterator must be a forward iterator over bytes");
+        return stream_matcher(expr).feed(begin, end);
+    }
+
+    /// @brief Matches a parsed simplex expression with the beginning of a string_view that may be incomplete.
+    /// @param expr The parsed simplex expression to match.
+    /// @param input The input received so far.
+    /// @return status simplex::status::need_more if the input ran out before the match was decided, otherwise whether it matches.
+    constexpr status partial_match(std::string_view expr, std::string_view input)
+    {
+        return stream_matcher(expr).feed(input);
+    }
+
+    /// @brief Position and length of a match within an input, see simplex::search().
+    struct search_result
+    {
+        /// @brief offset of the match within the input, simplex::npos if there is no match
+        size_t pos{npos};
+        /// @brief length of the match
+        size_t len{0};
+
+        constexpr explicit operator bool() const { return pos != npos; }
+    };
+
+    namespace internal
+    {
+        /// @brief search for the first match of a parsed simplex expression beginning before limit
+        /// @details only the start positions are limited, a match beginning before limit may extend past it, so a search for the
+        /// matches of one chunk of an input never scans the rest of it
+        constexpr search_result search_before(std::string_view expr, std::string_view input, const prefilter &filter, size_t limit)
+        {
+            if (expr.empty())
+                return limit ? search_result{0, 0} : search_result{};
+            const char *begin = input.data(), *end = input.data() + input.size(), *stop = begin + std::min(limit, input.size());
+            for (const char *p = filter.skip(begin, stop); p != stop; p = filter.skip(p + 1, stop))
+            {
+                const char *it = p;
+                if (consume(expr, it, end))
+                    return {size_t(p - begin), size_t(it - p)};
+            }
+            return {};
+        }
+    } // namespace internal
+
+    /// @brief Searches for the first match of a parsed simplex expression anywhere in a string_view.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param input The string_view to search.
+    /// @param filter The characters that may begin a match of expr.
+    /// @return search_result The position and length of the first match.
+    constexpr search_result search(std::string_view expr, std::string_view input, const internal::prefilter &filter)
+    {
+        return internal::search_before(expr, input, filter, npos);
+    }
+
+    /// @brief Searches for the first match of a parsed simplex expression anywhere in a string_view.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param input The string_view to search.
+    /// @return search_result The position and length of the first match.
+    /// @details Candidate positions are found by skipping to the characters that may begin a match (with memchr if there is only one),
+    /// so the expression is only matched where it can succeed.
+    constexpr search_result search(std::string_view expr, std::string_view input)
+    {
+        return search(expr, input, internal::prefilter(expr));
+    }
+
+    /// @brief A lazy range over the non-overlapping matches of a parsed simplex expression in a string_view, see simplex::find_all().
+    class match_range
+    {
+        std::string_view expr, input;
+        internal::prefilter filter;
+
+    public:
+        /// @brief search for the next match at or after offset from, and beginning before offset limit
+        constexpr search_result next(size_t from, size_t limit = npos) const
+        {
+            if (from > input.size() || from >= limit)
+                return {};
+            search_result found = internal::search_before(expr, input.substr(from), filter, limit == npos ? npos : limit - from);
+            if (found)
+                found.pos += from;
+            return found;
+        }
+
+        /// @brief the offset to search from after a match, an empty match is never followed by another match at the same offset
+        static constexpr size_t after(const search_result &found) { return found.pos + (found.len ? found.len : 1); }
+
+        class iterator
+        {
+            const match_range *range{nullptr};
+            search_result found{};
+
+        public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef std::string_view value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const std::string_view *pointer;
+            typedef std::string_view reference;
+
+            constexpr iterator() = default;
+            constexpr iterator(const match_range *range, search_result found) : range(range), found(found) {}
+
+            /// @brief the current match
+            constexpr std::string_view operator*() const { return range->input.substr(found.pos, found.len); }
+
+            constexpr iterator &operator++()
+            {
+                found = range->next(after(found));
+                return *this;
+            }
+
+            constexpr iterator operator++(int)
+            {
+                iterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            constexpr bool operator==(const iterator &other) const { return found.pos == other.found.pos; }
+            constexpr bool operator!=(const iterator &other) const { return !(*this == other); }
+        };
+
+        constexpr match_range(std::string_view expr, std::string_view input, const internal::prefilter &filter) : expr(expr), input(input), filter(filter) {}
+
+        constexpr iterator begin() const { return iterator(this, next(0)); }
+        constexpr iterator end() const { return iterator(this, {}); }
+
+        /// @brief count the matches without producing them
+        constexpr size_t count() const
+        {
+            size_t cnt{0};
+            for (search_result found = next(0); found; found = next(after(found)))
+                ++cnt;
+            return cnt;
+        }
+    };
+
+    /// @brief Finds all non-overlapping matches of a parsed simplex expression in a string_view.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param input The string_view to search.
+    /// @return match_range A lazy range of string_views over the matches within input, in order.
+    constexpr match_range find_all(std::string_view expr, std::string_view input)
+    {
+        return match_range(expr, input, internal::prefilter(expr));
+    }
+
+    /// @brief Counts all non-overlapping matches of a parsed simplex expression in a string_view.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param input The string_view to search.
+    /// @return size_t The number of matches within input.
+    constexpr size_t count(std::string_view expr, std::string_view input)
+    {
+        return find_all(expr, input).count();
+    }
+
+    /// @brief Matches a parsed simplex expression with many inputs, writing one result bit per input.
+    /// @param expr The parsed simplex expression to match.
+    /// @param filter The characters that may begin a match of expr.
+    /// @param inputs The string_views to match against.
+    /// @param n The number of inputs.
+    /// @param bits A bitmap of at least (n + 63) / 64 words, bit (i % 64) of word (i / 64) is set if inputs[i] matches and cleared otherwise.
+    /// @details Inputs that cannot begin a match are rejected by their first character, and upcoming inputs are prefetched.
+    inline void matches_batch(std::string_view expr, const internal::prefilter &filter, const std::string_view *inputs, size_t n, uint64_t *bits)
+    {
+        for (size_t i = 0; i < n; i += 64)
+        {
+            uint64_t word{0};
+            for (size_t j = 0, m = std::min<size_t>(n - i, 64); j < m; ++j)
+            {
+                if (i + j + SIMPLEX_PREFETCH_DISTANCE < n)
+                    SIMPLEX_PREFETCH(inputs[i + j + SIMPLEX_PREFETCH_DISTANCE].data());
+                const char *it = inputs[i + j].data(), *end = it + inputs[i + j].size();
+                bool res = expr.empty() || (it != end && filter.contains(internal::uchar(*it)) && internal::consume(expr, it, end));
+                word |= uint64_t(res) << j;
+            }
+            bits[i / 64] = word;
+        }
+    }
+
+    /// @brief Matches a parsed simplex expression with many inputs stored back to back, writing one result bit per input.
+    /// @tparam Offset The integer type of the offsets.
+    /// @param expr The parsed simplex expression to match.
+    /// @param filter The characters that may begin a match of expr.
+    /// @param data The characters of all inputs.
+    /// @param offsets The n + 1 offsets of the inputs within data, input i is [data + offsets[i], data + offsets[i + 1]).
+    /// @param n The number of inputs.
+    /// @param bits A bitmap of at least (n + 63) / 64 words, bit (i % 64) of word (i / 64) is set if input i matches and cleared otherwise.
+    template <typename Offset>
+    inline void matches_batch(std::string_view expr, const internal::prefilter &filter, const char *data, const Offset *offsets, size_t n, uint64_t *bits)
+    {
+        for (size_t i = 0; i < n; i += 64)
+        {
+            uint64_t word{0};
+            for (size_t j = 0, m = std::min<size_t>(n - i, 64); j < m; ++j)
+            {
+                if (i + j + SIMPLEX_PREFETCH_DISTANCE < n)
+                    SIMPLEX_PREFETCH(data + offsets[i + j + SIMPLEX_PREFETCH_DISTANCE]);
+                const char *it = data + offsets[i + j], *end = data + offsets[i + j + 1];
+                bool res = expr.empty() || (it != end && filter.contains(internal::uchar(*it)) && internal::consume(expr, it, end));
+                word |= uint64_t(res) << j;
+            }
+            bits[i / 64] = word;
+        }
+    }
+
+    namespace internal
+    {
+        /// @brief minimum number of characters scanned by each thread of the parallel functions
+        constexpr size_t parallel_min_chunk = size_t(1) << 16;
+
+        /// @brief the non-overlapping matches of a chunk of the input, found by scanning from the beginning of the chunk
+        struct chunk_matches
+        {
+            /// @brief the first matches, or all of them if they are kept
+            std::vector<search_result> head;
+            /// @brief the number of matches
+            size_t count{0};
+            /// @brief the offset to search from after the last match
+            size_t after{0};
+        };
+
+        /// @brief the matches beginning in a chunk [begin, end) of the input
+        /// @details a match examines at most extent characters, so the input is cut short past the chunk when extent is bounded
+        inline match_range chunk_range(std::string_view expr, const prefilter &filter, std::string_view input, size_t end, size_t extent)
+        {
+            return match_range(expr, input.substr(0, end + std::min(extent, input.size()) < input.size() ? end + extent : input.size()), filter);
+        }
+
+        /// @brief the limit of the start positions of the matches of a chunk [begin, end), see match_range::next()
+        /// @details the last chunk also holds the (empty) matches beginning at the end of the input
+        constexpr size_t chunk_limit(std::string_view input, size_t end) { return end >= input.size() ? npos : end; }
+
+        /// @brief find the non-overlapping matches beginning in a chunk [begin, end) of the input, scanning from begin
+        /// @param keep the maximum number of matches to keep in chunk_matches::head
+        inline chunk_matches scan_chunk(std::string_view expr, const prefilter &filter, std::string_view input, size_t begin, size_t end, size_t extent, size_t keep)
+        {
+            chunk_matches res;
+            match_range range = chunk_range(expr, filter, input, end, extent);
+            const size_t limit = chunk_limit(input, end);
+            for (search_result found = range.next(begin, limit); found; found = range.next(res.after, limit))
+            {
+                if (res.head.size() < keep)
+                    res.head.push_back(found);
+                ++res.count, res.after = match_range::after(found);
+            }
+            return res;
+        }
+
+        /// @brief the number of chunks an input is split into, one per thread, but none smaller than parallel_min_chunk
+        /// @param threads the number of threads, std::thread::hardware_concurrency() if 0
+        inline size_t parallel_chunk_count(size_t size, unsigned threads)
+        {
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            return std::max<size_t>(1, std::min<size_t>(threads, size / parallel_min_chunk));
+        }
+
+        /// @brief split an input into chunks scanned by separate threads, and call f(chunk, begin, end) for each chunk
+        /// @param chunks the number of chunks, see parallel_chunk_count()
+        /// @details the first chunk is scanned by the calling thread, as are the chunks left over if a thread cannot be created,
+        /// every thread is joined before returning, and the exception of the first failing chunk is rethrown
+        template <typename F>
+        void parallel_chunks(size_t size, size_t chunks, F &&f)
+        {
+            const size_t chunk = size / chunks;
+            std::vector<std::exception_ptr> errors(chunks);
+            auto scan = [&f, &errors, size, chunk, chunks](size_t i) noexcept
+            {
+                try
+                {
+                    f(i, i * chunk, i + 1 == chunks ? size : (i + 1) * chunk);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            };
+            std::vector<std::thread> workers;
+            workers.reserve(chunks - 1);
+            {
+                struct joiner
+                {
+                    std::vector<std::thread> &workers;
+                    ~joiner()
+                    {
+                        for (std::thread &worker : workers)
+                            worker.join();
+                    }
+                } join{workers};
+                size_t i = 1;
+                try
+                {
+                    for (; i < chunks; ++i)
+                        workers.emplace_back(scan, i);
+                }
+                catch (const std::system_error &)
+                { // out of threads, the rest of the chunks are scanned here
+                }
+                scan(0);
+                for (; i < chunks; ++i)
+                    scan(i);
+            }
+            for (const std::exception_ptr &error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        }
+
+        /// @brief scan every chunk of the input in parallel, and stitch the chunks together into the sequential non-overlapping matches
+        /// @param keep_all keep every match, otherwise only count them
+        /// @param out called with every match, in order, if keep_all
+        /// @return size_t the number of matches
+        template <typename F>
+        size_t parallel_scan(std::string_view expr, const prefilter &filter, std::string_view input, unsigned threads, bool keep_all, F &&out)
+        {
+            // without keeping every match, the first few are kept to find where a match straddling the previous chunk rejoins this one
+            constexpr size_t keep_few = 64;
+            const size_t ext = extent(expr);
+            const size_t n = parallel_chunk_count(input.size(), threads);
+            std::vector<chunk_matches> chunks(n);
+            std::vector<size_t> bounds(n + 1, input.size() + 1);
+            parallel_chunks(input.size(), n, [&](size_t i, size_t begin, size_t end)
+                            { bounds[i] = begin, chunks[i] = scan_chunk(expr, filter, input, begin, end, ext, keep_all ? npos : keep_few); });
+            bounds[n] = input.size() + 1;
+            match_range range(expr, input, filter);
+            size_t total{0}, next{0};
+            for (size_t i = 0; i < n; ++i)
+            {
+                const chunk_matches &chunk = chunks[i];
+                size_t head{0};
+                if (next > bounds[i])
+                { // a match straddled into this chunk, scan sequentially until a match coincides with the ones of this chunk
+                    const size_t limit = chunk_limit(input, bounds[i + 1]);
+                    search_result found = range.next(next, limit);
+                    for (; found; found = range.next(next, limit))
+                    {
+                        while (head < chunk.head.size() && chunk.head[head].pos < found.pos)
+                            ++head;
+                        if (head < chunk.head.size() && chunk.head[head].pos == found.pos)
+                            break;
+                        if (keep_all)
+                            out(found);
+                        ++total, next = match_range::after(found);
+                    }
+                    if (!found)
+                        continue;
+                }
+                for (size_t j = head; keep_all && j < chunk.head.size(); ++j)
+                    out(chunk.head[j]);
+                if (chunk.count > head)
+                    total += chunk.count - head, next = chunk.after;
+            }
+            return total;
+        }
+    } // namespace internal
+
+    /// @brief Searches for the first match of a parsed simplex expression anywhere in a string_view, using multiple threads.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param filter The characters that may begin a match of expr.
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return search_result The position and length of the first match, same as simplex::search().
+    /// @details The input is split into one chunk per thread, and each thread looks for the first match beginning within its chunk.
+    inline search_result parallel_search(std::string_view expr, const internal::prefilter &filter, std::string_view input, unsigned threads = 0)
+    {
+        const size_t ext = internal::extent(expr);
+        const size_t n = internal::parallel_chunk_count(input.size(), threads);
+        std::vector<search_result> found(n);
+        internal::parallel_chunks(input.size(), n, [&](size_t i, size_t begin, size_t end)
+                                  { found[i] = internal::chunk_range(expr, filter, input, end, ext).next(begin, internal::chunk_limit(input, end)); });
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (found[i])
+                return found[i];
+        }
+        return {};
+    }
+
+    /// @brief Counts all non-overlapping matches of a parsed simplex expression in a string_view, using multiple threads.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param filter The characters that may begin a match of expr.
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return size_t The number of matches within input, same as simplex::count().
+    /// @details The input is split into one chunk per thread, and each thread scans its chunk from its beginning. When a match straddles
+    /// into the next chunk, that chunk is rescanned sequentially from the end of the match until it rejoins the matches of the chunk.
+    inline size_t parallel_count(std::string_view expr, const internal::prefilter &filter, std::string_view input, unsigned threads = 0)
+    {
+        return internal::parallel_scan(expr, filter, input, threads, false, [](const search_result &) {});
+    }
+
+    /// @brief Finds all non-overlapping matches of a parsed simplex expression in a string_view, using multiple threads.
+    /// @param expr The parsed simplex expression to search for.
+    /// @param filter The characters that may begin a match of expr.
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return std::vector<std::string_view> The matches within input, in order, same as simplex::find_all().
+    inline std::vector<std::string_view> parallel_find_all(std::string_view expr, const internal::prefilter &filter, std::string_view input, unsigned threads = 0)
+    {
+        std::vector<std::string_view> res;
+        internal::parallel_scan(expr, filter, input, threads, true, [&res, &input](const search_result &found)
+                                { res.push_back(input.substr(found.pos, found.len)); });
+        return res;
+    }
+
+#if __cpp_nontype_template_args >= 201911L
+    namespace internal
+    {
+        /// @brief a string literal usable as a non-type template parameter
+        /// @tparam N the size of the string literal
+        template <size_t N>
+        struct fixed_string
+        {
+            char data[N]{};
+
+            constexpr fixed_string(const char (&str)[N])
+            {
+                for (size_t i = 0; i < N; ++i)
+                    data[i] = str[i];
+            }
+
+            constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+        };
+
+        /// @brief a simplex expression parsed at compile time into an exactly sized buffer
+        /// @tparam Expr the simplex expression
+        /// @tparam Enc the encoding of the expression, see simplex::encoding
+        template <fixed_string Expr, encoding Enc = encoding::bytes>
+        struct program
+        {
+            static constexpr size_t size = []
+            {
+                char buf[capacity(Expr.view().size()) + 1]{};
+                return optimize(std::begin(buf), std::begin(buf) + parse(Expr.view(), std::begin(buf), std::end(buf), Enc).size()).size();
+            }();
+
+            static constexpr std::array<char, size> code = []
+            {
+                char buf[capacity(Expr.view().size()) + 1]{};
+                std::string_view parsed = optimize(std::begin(buf), std::begin(buf) + parse(Expr.view(), std::begin(buf), std::end(buf), Enc).size());
+                std::array<char, size> res{};
+                for (size_t i = 0; i < size; ++i)
+                    res[i] = parsed[i];
+                return res;
+            }();
+
+            /// @brief op code at pos, as a constant expression
+            static constexpr uchar at(size_t pos) { return uchar(code[pos]); }
+
+            /// @brief the program, as a constant expression
+            static constexpr std::string_view view() { return std::string_view(code.data(), size); }
+
+            /// @brief size of the matching unit (and its NOT flag) at pos
+            static constexpr size_t unit_size(size_t pos)
+            {
+                return internal::unit_size(view(), pos);
+            }
+        };
+
+        /// @brief match one character against the matching unit at Pos of Program, which is not a NOT flag
+        template <typename Program, size_t Pos>
+        constexpr bool compiled_unit(const uchar cur)
+        {
+            if constexpr (Program::at(Pos) == ANY)
+                return any(std::string_view(Program::code.data() + Pos + 1, any_size), cur);
+            else
+                return cur == Program::at(Pos + 1);
+        }
+
+        /// @brief quantify the matching unit at Pos of Program, see internal::quantify
+        template <typename Program, size_t Pos, uint64_t Min, uint64_t Max, typename Iter>
+        constexpr bool compiled_quantify(Iter &begin, const Iter &end)
+        {
+            constexpr bool negated = Program::at(Pos) == NOT;
+            if constexpr (Program::at(Pos + negated) == UTF8)
+            {
+                uint64_t cnt = utf8_run(Program::view(), Pos + negated, begin, end, negated, Max == unbounded ? Max : Max + 1, true);
+                return cnt >= Min && cnt <= Max;
+            }
+            uint64_t cnt{0};
+            if constexpr (is_char_pointer<Iter>)
+            {
+                if (!SIMPLEX_CONSTANT_EVALUATED())
+                {
+                    constexpr uchar op = Program::at(Pos + negated);
+                    size_t n = Max < uint64_t(end - begin) ? size_t(Max) + 1 : size_t(end - begin);
+                    if constexpr (op == ANY)
+                        cnt = run(&*begin, n, std::string_view(Program::code.data() + Pos + negated + 1, any_size), negated);
+                    else
+                        cnt = run(&*begin, n, Program::at(Pos + negated + 1), negated);
+                    begin += cnt;
+                    return cnt >= Min && cnt <= Max;
+                }
+            }
+            for (; cnt <= Max && begin != end; ++cnt, ++begin)
+            {
+                if (negated == compiled_unit<Program, Pos + negated>(uchar(*begin)))
+                    return cnt >= Min;
+            }
+            return cnt >= Min && cnt <= Max;
+        }
+
+        /// @brief match the remainder of Program from Pos, see simplex::matches
+        /// @details every matching unit is its own specialization, so the op code dispatch is resolved at compile time
+        template <typename Program, size_t Pos, bool Negated, typename Iter>
+        constexpr bool compiled_matches(Iter begin, const Iter end)
+        {
+            if constexpr (Pos == Program::size)
+                return true;
+            else
+            {
+                if (begin == end)
+                    return false;
+                constexpr uchar op = Program::at(Pos);
+                if constexpr (op == NOT)
+                    return compiled_matches<Program, Pos + 1, true>(begin, end);
+                else
+                {
+                    bool res{false};
+                    constexpr decoded unit = decode(Program::view(), Pos);
+                    if constexpr (unit.quantified)
+                        res = compiled_quantify<Program, unit.at - unit.negated, unit.min, unit.max>(begin, end);
+                    else if constexpr (op == STRING)
+                        res = string(std::string_view(Program::code.data() + Pos + 2, Program::at(Pos + 1)), begin, end, uchar(*begin));
+                    else if constexpr (op == UTF8)
+                    {
+                        uchar cur = uchar(*begin);
+                        res = utf8_member(Program::view(), Pos, codepoint(begin, end, cur));
+                    }
+                    else
+                        res = compiled_unit<Program, Pos>(uchar(*begin)), ++begin;
+                    if (Negated == res)
+                        return false;
+                    return compiled_matches<Program, unit.next, false>(begin, end);
+                }
+            }
+        }
+    } // namespace internal
+
+    /// @brief A simplex expression parsed at compile time and expanded into a matcher without an op code interpreter (C++20).
+    /// @tparam Expr the simplex expression
+    /// @tparam Enc the encoding of the expression and its input, see simplex::encoding
+    ///
+    /// @example Match against a compiled simplex expression
+    /// @code
+    /// static_assert(simplex::compiled<"a*[bc]d">::matches("abbbcd"));
+    /// @endcode
+    template <internal::fixed_string Expr, encoding Enc = encoding::bytes>
+    struct compiled
+    {
+        /// @brief Get the parsed expression
+        static constexpr std::string_view expr() { return std::string_view(internal::program<Expr, Enc>::code.data(), internal::program<Expr, Enc>::size); }
+
+        /// @brief Match against a range of iterators.
+        /// @tparam Iter The type of the iterator.
+        /// @param begin The beginning of the range of iterators.
+        /// @param end The end of the range of iterators.
+        /// @return true If the range of iterators matches.
+        /// @return false If the range of iterators does not match.
+        template <typename Iter>
+        static constexpr bool matches(Iter begin, const Iter end)
+        {
+            static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && internal::is_byte<typename std::iterator_traits<Iter>::value_type>, "simplex::compiled::matches() iterator must be a forward iterator over bytes");
+            if constexpr (internal::is_byte_pointer<Iter>)
+            {
+                if (!SIMPLEX_CONSTANT_EVALUATED())
+                    return internal::compiled_matches<internal::program<Expr, Enc>, 0, false>(internal::chars(begin), internal::chars(end));
+            }
+            return internal::compiled_matches<internal::program<Expr, Enc>, 0, false>(begin, end);
+        }
+
+        /// @brief Match against a string_view.
+        /// @param input The string_view to match against.
+        /// @return true If the input matches.
+        /// @return false If the input does not match.
+        static constexpr bool matches(std::string_view input)
+        {
+            return matches<const char *>(input.data(), input.data() + input.size());
+        }
+    };
+
+    namespace literals
+    {
+        /// @brief Construct a simplex::compiled expression from a string literal, e.g. `"a*[bc]d"_sx`
+        template <internal::fixed_string Expr>
+        constexpr compiled<Expr> operator""_sx() { return {}; }
+    } // namespace literals
+#endif
+
+#if __cpp_impl_coroutine >= 201902L && __cpp_lib_coroutine >= 201902L
+    /// @brief A lazily started coroutine producing a value, see simplex::async_match() (C++20).
+    /// @tparam T the type of the value
+    /// @details A task can be co_awaited by another coroutine, or started with resume() and polled with done() by an event loop.
+    template <typename T>
+    class task
+    {
+    public:
+        struct promise_type
+        {
+            std::optional<T> value;
+            std::exception_ptr error;
+            std::coroutine_handle<> continuation;
+
+            task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            auto final_suspend() noexcept
+            {
+                struct awaiter
+                {
+                    bool await_ready() noexcept { return false; }
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+                    { // resume whoever awaited this task, if any
+                        std::coroutine_handle<> next = self.promise().continuation;
+                        return next ? next : std::noop_coroutine();
+                    }
+                    void await_resume() noexcept {}
+                };
+                return awaiter{};
+            }
+            void return_value(T res) { value.emplace(std::move(res)); }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        task(task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+        task &operator=(task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle)
+                    handle.destroy();
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        ~task()
+        {
+            if (handle)
+                handle.destroy();
+        }
+
+        /// @brief Start or continue the coroutine until it suspends or completes.
+        void resume() const
+        {
+            if (handle && !handle.done())
+                handle.resume();
+        }
+
+        /// @brief Check if the coroutine has completed.
+        bool done() const { return !handle || handle.done(); }
+
+        /// @brief The value of a completed coroutine, rethrowing its exception if it failed.
+        T result() const
+        {
+            if (handle.promise().error)
+                std::rethrow_exception(handle.promise().error);
+            if (!handle.promise().value)
+                throw std::logic_error("simplex::task::result(): the task has not completed");
+            return *handle.promise().value;
+        }
+
+        auto operator co_await() const noexcept
+        {
+            struct awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+                bool await_ready() noexcept { return handle.done(); }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                { // start this task, it resumes the awaiting coroutine when it completes
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+                T await_resume()
+                {
+                    if (handle.promise().error)
+                        std::rethrow_exception(handle.promise().error);
+                    return std::move(*handle.promise().value);
+                }
+            };
+            return awaiter{handle};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+        explicit task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    };
+
+    /// @brief Matches a parsed simplex expression against an asynchronous byte source, suspending while no input is available (C++20).
+    /// @tparam Source A type with a read() member returning an awaitable of the next chunk of input, convertible to std::string_view,
+    /// where an empty chunk is the end of the input.
+    /// @param expr The parsed simplex expression to match, which must outlive the task.
+    /// @param source The source of the input, which must outlive the task.
+    /// @return task<status> A task completing with simplex::status::match or simplex::status::no_match as soon as the match is decided,
+    /// without reading the rest of the input.
+    /// @details Every chunk is fed to a simplex::stream_matcher, so no input is buffered and each connection only needs its coroutine frame.
+    template <typename Source>
+    task<status> async_match(std::string_view expr, Source &source)
     {
-        return matches<std::string_view::iterator>(expr, input.begin(), input.end());
+        stream_matcher matcher(expr);
+        while (matcher.state() == status::need_more)
+        {
+            std::string_view chunk = co_await source.read();
+            if (chunk.empty())
+                co_return matcher.finish();
+            matcher.feed(chunk);
+        }
+        co_return matcher.state();
     }
+#endif
 }; // namespace simplex
 
 /// @brief A contexpr-parsed simplex expression that can be used to match against an input with `Simplex::matches()`
@@ -317,6 +2232,7 @@ class Simplex
 
     Container buf;
     size_t len{0};
+    simplex::internal::prefilter filter{std::string_view()};
 
 public:
     typedef char value_type;
@@ -328,22 +2244,33 @@ public:
     /// @brief Construct a Simplex expression from a string literal
     /// @tparam N the size of the string literal
     /// @param expr the string literal to parse
+    /// @param enc the encoding of the expression and its input, see simplex::encoding
     template <size_t N>
-    constexpr Simplex(const char (&expr)[N]) : buf(), len(simplex::parse(std::string_view(expr, N - 1), std::begin(buf), std::end(buf)).size())
+    constexpr Simplex(const char (&expr)[N], simplex::encoding enc = simplex::encoding::bytes) : buf(), len(simplex::optimize(std::begin(buf), std::begin(buf) + simplex::parse(std::string_view(expr, N - 1), std::begin(buf), std::end(buf), enc).size()).size()), filter(this->expr())
     {
-        static_assert(std::is_same<Container, char[N - 1]>::value, "Simplex container must be char[N - 1] when constructing via Simplex(const char (&)[N])");
+        static_assert(std::is_same<Container, char[simplex::capacity(N - 1)]>::value, "Simplex container must be char[simplex::capacity(N - 1)] when constructing via Simplex(const char (&)[N])");
     }
 
     /// @brief Construct a Simplex expression from a string_view
     /// @tparam ...Args the types of the arguments to pass to the container constructor
     /// @param expr the string_view to parse
     /// @param ...args the arguments to pass to the container constructor
+    /// @attention the container should hold at least simplex::capacity(expr.size()) chars
+    template <typename... Args>
+    constexpr Simplex(std::string_view expr, Args... args) : Simplex(simplex::encoding::bytes, expr, args...) {}
+
+    /// @brief Construct a Simplex expression from a string_view in an encoding
+    /// @tparam ...Args the types of the arguments to pass to the container constructor
+    /// @param enc the encoding of the expression and its input, see simplex::encoding
+    /// @param expr the string_view to parse
+    /// @param ...args the arguments to pass to the container constructor
+    /// @attention the container should hold at least simplex::capacity(expr.size()) chars
     template <typename... Args>
-    constexpr Simplex(std::string_view expr, Args... args) : buf(args...)
+    constexpr Simplex(simplex::encoding enc, std::string_view expr, Args... args) : buf(args...)
     {
-        if (expr.size() > std::size(buf))
-            throw std::logic_error("simplex expression too large for Simplex container");
-        len = simplex::parse(expr, std::begin(buf), std::end(buf)).size();
+        len = simplex::parse(expr, std::begin(buf), std::end(buf), enc).size();
+        len = simplex::optimize(std::begin(buf), std::next(std::begin(buf), std::ptrdiff_t(len))).size();
+        filter = simplex::internal::prefilter(this->expr());
     }
 
     /// @brief Get a const reference to the inner buffer used to store the parsed expression
@@ -352,6 +2279,13 @@ public:
     /// @brief Get the parsed expression
     inline constexpr std::string_view expr() const { return std::string_view(&(*std::begin(buf)), len); }
 
+    /// @brief Release the space reserved for parsing, for a resizable container such as std::string
+    void shrink_to_fit()
+    {
+        buf.resize(len);
+        buf.shrink_to_fit();
+    }
+
     /// @brief Match against a range of iterators.
     /// @tparam Iter The type of the iterator.
     /// @param begin The beginning of the range of iterators.
@@ -359,7 +2293,7 @@ public:
     /// @return true If the range of iterators matches.
     /// @return false If the range of iterators does not match.
     template <typename Iter>
-    inline bool matches(Iter begin, const Iter end) const
+    inline constexpr bool matches(Iter begin, const Iter end) const
     {
         return simplex::matches<Iter>(this->expr(), begin, end);
     }
@@ -368,13 +2302,582 @@ public:
     /// @param input The string_view to match against.
     /// @return true If the input matches.
     /// @return false If the input does not match.
-    inline bool matches(std::string_view input) const
+    inline constexpr bool matches(std::string_view input) const
     {
         return simplex::matches(this->expr(), input);
     }
+
+    /// @brief Match against a range of iterators, and get where the match ended.
+    /// @tparam Iter The type of the iterator.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the range of iterators.
+    /// @return std::optional<Iter> The iterator past the last character consumed by the match, if any.
+    template <typename Iter>
+    inline constexpr std::optional<Iter> match(Iter begin, const Iter end) const
+    {
+        return simplex::match<Iter>(this->expr(), begin, end);
+    }
+
+    /// @brief Match against a string_view, and get the length of the match.
+    /// @param input The string_view to match against.
+    /// @return size_t The number of characters consumed by the match, or simplex::npos if the input does not match.
+    inline constexpr size_t match(std::string_view input) const
+    {
+        return simplex::match(this->expr(), input);
+    }
+
+    /// @brief Match against an entire range of iterators.
+    /// @tparam Iter The type of the iterator.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the range of iterators.
+    /// @return true If the entire range of iterators matches.
+    /// @return false Otherwise.
+    template <typename Iter>
+    inline constexpr bool full_match(Iter begin, const Iter end) const
+    {
+        return simplex::full_match<Iter>(this->expr(), begin, end);
+    }
+
+    /// @brief Match against an entire string_view.
+    /// @param input The string_view to match against.
+    /// @return true If the entire input matches.
+    /// @return false Otherwise.
+    inline constexpr bool full_match(std::string_view input) const
+    {
+        return simplex::full_match(this->expr(), input);
+    }
+
+    /// @brief Match against the beginning of a range of iterators that may be incomplete.
+    /// @tparam Iter The type of the iterator.
+    /// @param begin The beginning of the range of iterators.
+    /// @param end The end of the input received so far.
+    /// @return simplex::status simplex::status::need_more if the input ran out before the match was decided.
+    template <typename Iter>
+    inline constexpr simplex::status partial_match(Iter begin, const Iter end) const
+    {
+        return simplex::partial_match<Iter>(this->expr(), begin, end);
+    }
+
+    /// @brief Match against the beginning of a string_view that may be incomplete.
+    /// @param input The input received so far.
+    /// @return simplex::status simplex::status::need_more if the input ran out before the match was decided.
+    inline constexpr simplex::status partial_match(std::string_view input) const
+    {
+        return simplex::partial_match(this->expr(), input);
+    }
+
+#if __cpp_impl_coroutine >= 201902L && __cpp_lib_coroutine >= 201902L
+    /// @brief Match against an asynchronous byte source, see simplex::async_match() (C++20).
+    /// @tparam Source A type with a read() member returning an awaitable of the next chunk of input, empty at the end of the input.
+    /// @param source The source of the input, which must outlive the task, as must this expression.
+    /// @return simplex::task<simplex::status> A task completing with the result of the match.
+    template <typename Source>
+    inline simplex::task<simplex::status> async_match(Source &source) const
+    {
+        return simplex::async_match(this->expr(), source);
+    }
+#endif
+
+    /// @brief Create a simplex::stream_matcher to match input arriving in chunks.
+    /// @return simplex::stream_matcher A matcher referring to this expression, which must outlive it.
+    inline constexpr simplex::stream_matcher stream() const
+    {
+        return simplex::stream_matcher(this->expr());
+    }
+
+    /// @brief Search for the first match anywhere in a string_view.
+    /// @param input The string_view to search.
+    /// @return simplex::search_result The position and length of the first match, if any.
+    inline constexpr simplex::search_result search(std::string_view input) const
+    {
+        return simplex::search(this->expr(), input, filter);
+    }
+
+    /// @brief Find all non-overlapping matches in a string_view.
+    /// @param input The string_view to search.
+    /// @return simplex::match_range A lazy range of string_views over the matches within input, in order.
+    inline constexpr simplex::match_range find_all(std::string_view input) const
+    {
+        return simplex::match_range(this->expr(), input, filter);
+    }
+
+    /// @brief Count all non-overlapping matches in a string_view.
+    /// @param input The string_view to search.
+    /// @return size_t The number of matches within input.
+    inline constexpr size_t count(std::string_view input) const
+    {
+        return simplex::match_range(this->expr(), input, filter).count();
+    }
+
+    /// @brief Match against many inputs, writing one result bit per input.
+    /// @param inputs The string_views to match against.
+    /// @param n The number of inputs.
+    /// @param bits A bitmap of at least (n + 63) / 64 words, bit (i % 64) of word (i / 64) is set if inputs[i] matches and cleared otherwise.
+    inline void matches_batch(const std::string_view *inputs, size_t n, uint64_t *bits) const
+    {
+        simplex::matches_batch(this->expr(), filter, inputs, n, bits);
+    }
+
+    /// @brief Match against many inputs stored back to back, writing one result bit per input.
+    /// @tparam Offset The integer type of the offsets.
+    /// @param data The characters of all inputs.
+    /// @param offsets The n + 1 offsets of the inputs within data, input i is [data + offsets[i], data + offsets[i + 1]).
+    /// @param n The number of inputs.
+    /// @param bits A bitmap of at least (n + 63) / 64 words, bit (i % 64) of word (i / 64) is set if input i matches and cleared otherwise.
+    template <typename Offset>
+    inline void matches_batch(const char *data, const Offset *offsets, size_t n, uint64_t *bits) const
+    {
+        simplex::matches_batch(this->expr(), filter, data, offsets, n, bits);
+    }
+
+    /// @brief Search for the first match anywhere in a string_view, using multiple threads, see simplex::parallel_search().
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return simplex::search_result The position and length of the first match, if any.
+    inline simplex::search_result parallel_search(std::string_view input, unsigned threads = 0) const
+    {
+        return simplex::parallel_search(this->expr(), filter, input, threads);
+    }
+
+    /// @brief Count all non-overlapping matches in a string_view, using multiple threads, see simplex::parallel_count().
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return size_t The number of matches within input.
+    inline size_t parallel_count(std::string_view input, unsigned threads = 0) const
+    {
+        return simplex::parallel_count(this->expr(), filter, input, threads);
+    }
+
+    /// @brief Find all non-overlapping matches in a string_view, using multiple threads, see simplex::parallel_find_all().
+    /// @param input The string_view to search.
+    /// @param threads The number of threads to use, std::thread::hardware_concurrency() if 0.
+    /// @return std::vector<std::string_view> The matches within input, in order.
+    inline std::vector<std::string_view> parallel_find_all(std::string_view input, unsigned threads = 0) const
+    {
+        return simplex::parallel_find_all(this->expr(), filter, input, threads);
+    }
+
+#if __cpp_lib_span >= 202002L
+    /// @brief Match against many inputs, writing one result bit per input.
+    /// @param inputs The string_views to match against.
+    /// @param bits A bitmap of at least (inputs.size() + 63) / 64 words, see matches_batch(const std::string_view *, size_t, uint64_t *).
+    inline void matches_batch(std::span<const std::string_view> inputs, std::span<uint64_t> bits) const
+    {
+        if (bits.size() < (inputs.size() + 63) / 64)
+            throw std::length_error("Simplex::matches_batch(): bitmap too small for inputs");
+        simplex::matches_batch(this->expr(), filter, inputs.data(), inputs.size(), bits.data());
+    }
+#endif
 };
 
 template <size_t N>
-Simplex(const char (&expr)[N]) -> Simplex<char[N - 1]>;
+Simplex(const char (&expr)[N]) -> Simplex<char[simplex::capacity(N - 1)]>;
+template <size_t N>
+Simplex(const char (&expr)[N], simplex::encoding) -> Simplex<char[simplex::capacity(N - 1)]>;
+
+/// @brief A set of simplex expressions matched against the same input at once, see `SimplexSet::matches()`
+/// @details The parsed expressions are stored back to back, and every expression is indexed by the characters that may begin
+/// one of its matches, so only the expressions that can match the first character of an input are ever run against it.
+///
+/// @example Route an input to the expressions that match it
+/// @code
+/// SimplexSet set{"GET +!\n", "POST +!\n", "+[-AZ] /"};
+/// std::vector<size_t> ids = set.matches("GET /index.html"); // {0, 2}
+/// @endcode
+class SimplexSet
+{
+    std::string code;
+    std::vector<size_t> offsets{0};
+    /// @brief ids of the expressions that may match an input beginning with each character
+    std::array<std::vector<uint32_t>, simplex::internal::any_size * 8> dispatch;
+    /// @brief ids of the expressions that match an empty input
+    std::vector<uint32_t> empty;
+
+    /// @brief index an expression that was just appended to code
+    size_t index()
+    {
+        size_t id = offsets.size() - 1;
+        offsets.push_back(code.size());
+        std::string_view parsed = expr(id);
+        if (parsed.empty())
+            empty.push_back(uint32_t(id));
+        simplex::internal::prefilter filter(parsed);
+        for (unsigned c = 0; c < dispatch.size(); ++c)
+        {
+            if (filter.contains(simplex::internal::uchar(c)))
+                dispatch[c].push_back(uint32_t(id));
+        }
+        return id;
+    }
+
+public:
+    SimplexSet() = default;
+
+    /// @brief Construct a SimplexSet from simplex expressions
+    /// @param exprs the simplex expressions to parse, their ids are their indices
+    SimplexSet(std::initializer_list<std::string_view> exprs)
+    {
+        for (std::string_view expr : exprs)
+            add(expr);
+    }
+
+    /// @brief Parse and add a simplex expression
+    /// @param expr the simplex expression to parse
+    /// @param enc the encoding of the expression and its input, see simplex::encoding
+    /// @return size_t the id of the expression
+    size_t add(std::string_view expr, simplex::encoding enc = simplex::encoding::bytes)
+    {
+        if (!expr.empty())
+        {
+            size_t offset = code.size();
+            code.resize(offset + simplex::capacity(expr.size()));
+            try
+            {
+                code.resize(offset + simplex::parse(expr, code.begin() + std::ptrdiff_t(offset), code.end(), enc).size());
+            }
+            catch (...)
+            { // drop the scratch space, so the next expression is not appended after it
+                code.resize(offset);
+                throw;
+            }
+            code.resize(offset + simplex::optimize(code.begin() + std::ptrdiff_t(offset), code.end()).size());
+        }
+        return index();
+    }
+
+    /// @brief Add an already parsed Simplex expression
+    /// @param simplex the Simplex expression to add
+    /// @return size_t the id of the expression
+    template <typename Container>
+    size_t add(const Simplex<Container> &simplex)
+    {
+        code.append(simplex.expr());
+        return index();
+    }
+
+    /// @brief Get the number of expressions in the set
+    inline size_t size() const { return offsets.size() - 1; }
+
+    /// @brief Get the parsed expression with the given id
+    inline std::string_view expr(size_t id) const { return std::string_view(code).substr(offsets[id], offsets[id + 1] - offsets[id]); }
+
+    /// @brief Call a function with the id of every expression that matches the beginning of an input, in ascending order.
+    /// @param input The string_view to match against.
+    /// @param f The function to call with each matching id.
+    template <typename F>
+    void for_each_match(std::string_view input, F &&f) const
+    {
+        const std::vector<uint32_t> &candidates = input.empty() ? empty : dispatch[simplex::internal::uchar(input.front())];
+        for (uint32_t id : candidates)
+        {
+            if (simplex::matches(expr(id), input))
+                f(size_t(id));
+        }
+    }
+
+    /// @brief Get the ids of all expressions that match the beginning of an input.
+    /// @param input The string_view to match against.
+    /// @return std::vector<size_t> The ids of the matching expressions, in ascending order.
+    std::vector<size_t> matches(std::string_view input) const
+    {
+        std::vector<size_t> ids;
+        for_each_match(input, [&ids](size_t id)
+                       { ids.push_back(id); });
+        return ids;
+    }
+
+    /// @brief Set the bit of every expression that matches the beginning of an input.
+    /// @param input The string_view to match against.
+    /// @param bits A bitmask of at least (size() + 63) / 64 words, bit (id % 64) of word (id / 64) is set for every matching id, other bits are left unchanged.
+    void matches(std::string_view input, uint64_t *bits) const
+    {
+        for_each_match(input, [bits](size_t id)
+                       { bits[id / 64] |= uint64_t(1) << (id % 64); });
+    }
+};
+
+/// @brief Simplex expressions parsed at run time into a single allocation, see `SimplexArena::SimplexArena()`
+/// @details The offsets of the parsed expressions and the parsed expressions themselves, back to back, share one allocation of
+/// exactly their size, so thousands of expressions are kept in one block, iterating over them reads memory in order, and freeing
+/// them deallocates once.
+///
+/// @example Parse the expressions of a rule file at startup
+/// @code
+/// std::vector<std::string> rules = read_rules();
+/// SimplexArena arena(rules.begin(), rules.end());
+/// bool hit = arena.matches(42, "GET /index.html"); // rule 42
+/// @endcode
+class SimplexArena
+{
+    /// @brief size() + 1 offsets, followed by the parsed expressions
+    std::unique_ptr<size_t[]> arena;
+    size_t count{0};
+
+    const char *code() const { return reinterpret_cast<const char *>(arena.get() + count + 1); }
+
+public:
+    SimplexArena() = default;
+
+    /// @brief Parse a range of simplex expressions, their ids are their indices
+    /// @tparam Iter a forward iterator over strings convertible to std::string_view
+    /// @param begin The beginning of the expressions.
+    /// @param end The end of the expressions.
+    /// @param enc The encoding of the expressions and their input, see simplex::encoding.
+    /// @throws std::logic_error If there is a syntax error in an expression.
+    template <typename Iter>
+    SimplexArena(Iter begin, const Iter end, simplex::encoding enc = simplex::encoding::bytes)
+    {
+        static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value && std::is_convertible<typename std::iterator_traits<Iter>::value_type, std::string_view>::value, "SimplexArena() iterator must be a forward iterator over strings");
+        size_t longest{0};
+        for (Iter it = begin; it != end; ++it, ++count)
+            longest = std::max(longest, std::string_view(*it).size());
+        // every expression is parsed into the same scratch buffer, sized for the worst case, so the arena holds exactly the programs
+        std::string scratch(std::max<size_t>(1, simplex::capacity(longest)), '\0'), code;
+        std::vector<size_t> offsets(count + 1, 0);
+        for (size_t id = 1; begin != end; ++begin, ++id)
+        {
+            std::string_view expr(*begin);
+            code.append(simplex::optimize(scratch.begin(), scratch.begin() + std::ptrdiff_t(simplex::parse(expr, scratch.begin(), scratch.end(), enc).size())));
+            offsets[id] = code.size();
+        }
+        arena.reset(new size_t[count + 1 + (code.size() + sizeof(size_t) - 1) / sizeof(size_t)]);
+        std::copy(offsets.begin(), offsets.end(), arena.get());
+        std::copy(code.begin(), code.end(), reinterpret_cast<char *>(arena.get() + count + 1));
+    }
+
+    /// @brief Parse simplex expressions, their ids are their indices
+    /// @param exprs The simplex expressions to parse.
+    /// @param enc The encoding of the expressions and their input, see simplex::encoding.
+    SimplexArena(std::initializer_list<std::string_view> exprs, simplex::encoding enc = simplex::encoding::bytes) : SimplexArena(exprs.begin(), exprs.end(), enc) {}
+
+    /// @brief Get the number of expressions
+    inline size_t size() const { return count; }
+
+    /// @brief Get the parsed expression with the given id
+    inline std::string_view expr(size_t id) const { return std::string_view(code() + arena[id], arena[id + 1] - arena[id]); }
+
+    /// @brief Match the expression with the given id against a string_view, see simplex::matches().
+    inline bool matches(size_t id, std::string_view input) const { return simplex::matches(expr(id), input); }
+
+    /// @brief Match the expression with the given id against a string_view, and return the length of the match, see simplex::match().
+    inline size_t match(size_t id, std::string_view input) const { return simplex::match(expr(id), input); }
+
+    /// @brief Match the expression with the given id against an entire string_view, see simplex::full_match().
+    inline bool full_match(size_t id, std::string_view input) const { return simplex::full_match(expr(id), input); }
+
+    /// @brief Serialize the parsed expressions, and the characters that may begin their matches, into an image for SimplexDatabase
+    /// @return std::string The image, versioned and little-endian, which holds no pointers so it can be written to a file and mapped anywhere.
+    /// @throws std::logic_error On big-endian hosts.
+    std::string serialize() const
+    {
+        using namespace simplex::internal;
+#ifdef SIMPLEX_BIG_ENDIAN
+        throw std::logic_error("simplex::SimplexArena::serialize(): images are little-endian");
+#endif
+        size_t records = sizeof(image_header) + count * sizeof(image_record), bytes = arena ? arena[count] : 0;
+        // every field is copied on its own, so the padding of the structs is always zero and equal arenas have equal images
+        std::string image(records + bytes, '\0');
+        char *out = image.data();
+        auto put = [out](size_t at, const void *field, size_t size)
+        { std::memcpy(out + at, field, size); };
+        image_header header{{}, image_version, uint32_t(sizeof(image_record)), uint64_t(count), uint64_t(image.size())};
+        put(offsetof(image_header, magic), image_magic, sizeof(image_magic));
+        put(offsetof(image_header, version), &header.version, sizeof(header.version));
+        put(offsetof(image_header, record_size), &header.record_size, sizeof(header.record_size));
+        put(offsetof(image_header, count), &header.count, sizeof(header.count));
+        put(offsetof(image_header, size), &header.size, sizeof(header.size));
+        for (size_t id = 0; id < count; ++id)
+        {
+            size_t at = sizeof(image_header) + id * sizeof(image_record);
+            image_record record{uint64_t(records + arena[id]), uint64_t(arena[id + 1] - arena[id]), prefilter(expr(id))};
+            put(at + offsetof(image_record, offset), &record.offset, sizeof(record.offset));
+            put(at + offsetof(image_record, size), &record.size, sizeof(record.size));
+            at += offsetof(image_record, filter);
+            put(at + offsetof(prefilter, set), record.filter.set, sizeof(record.filter.set));
+            put(at + offsetof(prefilter, count), &record.filter.count, sizeof(record.filter.count));
+            put(at + offsetof(prefilter, first), &record.filter.first, sizeof(record.filter.first));
+        }
+        if (bytes)
+            put(records, code(), bytes);
+        return image;
+    }
+};
+
+/// @brief Parsed simplex expressions used in place from a serialized image, see `SimplexArena::serialize()`
+/// @details Loading an image only checks its header and the bounds of its records, nothing is parsed or copied, so an image
+/// memory-mapped from a file is ready at once, and processes mapping the same file share one copy of it in the page cache.
+/// The image is not owned and must outlive the SimplexDatabase. The parsed programs themselves are trusted, only load images
+/// written by SimplexArena::serialize().
+///
+/// @example Write a rule database once, and map it in every worker
+/// @code
+/// std::string image = SimplexArena(rules.begin(), rules.end()).serialize(); // written to rules.sxdb
+/// // in a worker, with fd open on rules.sxdb
+/// void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+/// SimplexDatabase db(data, size);
+/// simplex::search_result hit = db.search(42, request); // rule 42
+/// @endcode
+class SimplexDatabase
+{
+    const char *image{nullptr};
+    const simplex::internal::image_record *records{nullptr};
+    size_t count{0};
+
+public:
+    SimplexDatabase() = default;
+
+    /// @brief Use a serialized image in place
+    /// @param data The image, aligned to 8 bytes (memory-mapped files are page-aligned).
+    /// @param size The number of bytes available at data, at least the size of the image.
+    /// @throws std::logic_error If the image is misaligned, truncated, or of another version or byte order.
+    SimplexDatabase(const void *data, size_t size) : image(static_cast<const char *>(data))
+    {
+        using namespace simplex::internal;
+#ifdef SIMPLEX_BIG_ENDIAN
+        throw std::logic_error("simplex::SimplexDatabase(): images are little-endian");
+#endif
+        if (reinterpret_cast<uintptr_t>(data) % alignof(image_record) != 0)
+            throw std::logic_error("simplex::SimplexDatabase(): misaligned image");
+        const image_header *header = reinterpret_cast<const image_header *>(data);
+        if (size < sizeof(image_header) || std::memcmp(header->magic, image_magic, sizeof(image_magic)) != 0)
+            throw std::logic_error("simplex::SimplexDatabase(): not a simplex image");
+        if (header->version != image_version || header->record_size != sizeof(image_record))
+            throw std::logic_error("simplex::SimplexDatabase(): unsupported image version");
+        uint64_t end = header->size;
+        if (end > size || end < sizeof(image_header) || header->count > (end - sizeof(image_header)) / sizeof(image_record))
+            throw std::logic_error("simplex::SimplexDatabase(): truncated image");
+        records = reinterpret_cast<const image_record *>(image + sizeof(image_header));
+        uint64_t begin = sizeof(image_header) + header->count * sizeof(image_record);
+        for (const image_record *r = records; r != records + header->count; ++r)
+        {
+            if (r->offset < begin || r->offset > end || r->size > end - r->offset)
+                throw std::logic_error("simplex::SimplexDatabase(): truncated image");
+        }
+        count = size_t(header->count);
+    }
+
+    /// @brief Get the number of expressions
+    inline size_t size() const { return count; }
+
+    /// @brief Get the parsed expression with the given id
+    inline std::string_view expr(size_t id) const { return std::string_view(image + records[id].offset, size_t(records[id].size)); }
+
+    /// @brief Match the expression with the given id against a string_view, see simplex::matches().
+    inline bool matches(size_t id, std::string_view input) const { return simplex::matches(expr(id), input); }
+
+    /// @brief Match the expression with the given id against a string_view, and return the length of the match, see simplex::match().
+    inline size_t match(size_t id, std::string_view input) const { return simplex::match(expr(id), input); }
+
+    /// @brief Match the expression with the given id against an entire string_view, see simplex::full_match().
+    inline bool full_match(size_t id, std::string_view input) const { return simplex::full_match(expr(id), input); }
+
+    /// @brief Search for the first match of the expression with the given id, with its serialized prefilter, see simplex::search().
+    inline simplex::search_result search(size_t id, std::string_view input) const { return simplex::search(expr(id), input, records[id].filter); }
+};
+
+/// @brief A thread-safe cache of simplex expressions parsed at run time, see `SimplexRegistry::get()`
+/// @details Every distinct expression (and encoding) is parsed once, and shared through handles to an immutable Simplex. The least
+/// recently used expressions are evicted beyond max_size(), a handle keeps its Simplex alive after it is evicted.
+///
+/// @example Share the matchers of rules read from a configuration
+/// @code
+/// SimplexRegistry registry;
+/// SimplexRegistry::handle rule = registry.get("GET +!\n"); // parsed once for every rule with this expression
+/// bool hit = rule->matches("GET /index.html\n");
+/// @endcode
+class SimplexRegistry
+{
+public:
+    typedef std::shared_ptr<const Simplex<std::string>> handle;
+
+private:
+    struct entry
+    {
+        std::string expr;
+        simplex::encoding enc;
+        handle simplex;
+    };
+
+    struct key
+    {
+        /// @brief the expression of an entry, or the expression looked up
+        std::string_view expr;
+        simplex::encoding enc;
+
+        bool operator==(const key &other) const { return expr == other.expr && enc == other.enc; }
+    };
+
+    struct key_hash
+    {
+        size_t operator()(const key &k) const { return std::hash<std::string_view>()(k.expr) ^ size_t(k.enc); }
+    };
+
+    mutable std::mutex mutex;
+    /// @brief most recently used first, list nodes never move so the keys of index can refer to their expressions
+    std::list<entry> lru;
+    std::unordered_map<key, std::list<entry>::iterator, key_hash> index;
+    size_t limit;
+
+    /// @brief move a cached expression to the front, the mutex must be held
+    const handle *find(std::string_view expr, simplex::encoding enc)
+    {
+        auto it = index.find(key{expr, enc});
+        if (it == index.end())
+            return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return &it->second->simplex;
+    }
+
+public:
+    /// @brief Construct an empty SimplexRegistry
+    /// @param max_size the number of expressions kept before the least recently used are evicted
+    explicit SimplexRegistry(size_t max_size = 4096) : limit(max_size) {}
+
+    /// @brief Get the parsed Simplex of an expression, parsing it only if it is not cached
+    /// @param expr the simplex expression
+    /// @param enc the encoding of the expression and its input, see simplex::encoding
+    /// @return handle a shared handle to the parsed expression, the same for every call while it is cached
+    /// @throws std::logic_error If there is a syntax error in the expression, which is not cached.
+    handle get(std::string_view expr, simplex::encoding enc = simplex::encoding::bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (const handle *found = find(expr, enc))
+                return *found;
+        }
+        // parse without holding the lock, so lookups of other expressions are not blocked
+        auto parsed = std::make_shared<Simplex<std::string>>(enc, expr, simplex::capacity(expr.size()), '\0');
+        parsed->shrink_to_fit();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (const handle *found = find(expr, enc))
+            return *found; // another thread parsed it first
+        lru.push_front(entry{std::string(expr), enc, parsed});
+        index.emplace(key{lru.front().expr, enc}, lru.begin());
+        while (lru.size() > limit)
+        {
+            index.erase(key{lru.back().expr, lru.back().enc});
+            lru.pop_back();
+        }
+        return parsed;
+    }
+
+    /// @brief Get the number of cached expressions
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lru.size();
+    }
+
+    /// @brief Get the number of expressions kept before the least recently used are evicted
+    size_t max_size() const { return limit; }
+
+    /// @brief Evict every expression, handles already given out stay valid
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index.clear();
+        lru.clear();
+    }
+};
 
 #endif // SIMPLEX_HPP
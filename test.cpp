@@ -1,12 +1,84 @@
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
+#include <vector>
 #include "simplex.hpp"
 
 using namespace std::literals;
 
+#if __cpp_nontype_template_args >= 201911L
+#define COMPILED_TEST(expr, input, expected)                                                                                           \
+    if (simplex::compiled<expr>::matches(input##sv) != expected)                                                                       \
+    {                                                                                                                                  \
+        std::cerr << "[FAIL] compiled<\"" expr "\">::matches(\"" input "\")!=" << (expected ? "true" : "false") << std::endl; \
+        exitCode = 1;                                                                                                                  \
+    }
+#else
+#define COMPILED_TEST(expr, input, expected)
+#endif
+
+/// @brief a single-pass iterator counting how many times each character is read
+struct counting_iterator
+{
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char *;
+    using reference = char;
+
+    const char *p;
+    std::vector<int> *reads;
+    const char *base;
+
+    char operator*() const { return ++(*reads)[size_t(p - base)], *p; }
+    counting_iterator &operator++() { return ++p, *this; }
+    bool operator==(const counting_iterator &other) const { return p == other.p; }
+    bool operator!=(const counting_iterator &other) const { return p != other.p; }
+};
+
+#if __cpp_impl_coroutine >= 201902L && __cpp_lib_coroutine >= 201902L
+/// @brief an asynchronous source of chunks pushed by an event loop, suspending readers until a chunk arrives
+struct chunk_source
+{
+    std::deque<std::string> chunks;
+    size_t next{0};
+    std::coroutine_handle<> waiting;
+
+    auto read()
+    {
+        struct awaiter
+        {
+            chunk_source *source;
+            bool await_ready() { return source->next < source->chunks.size(); }
+            void await_suspend(std::coroutine_handle<> handle) { source->waiting = handle; }
+            std::string_view await_resume() { return source->chunks[source->next++]; }
+        };
+        return awaiter{this};
+    }
+
+    void push(std::string chunk)
+    {
+        chunks.push_back(std::move(chunk));
+        if (std::coroutine_handle<> handle = std::exchange(waiting, {}))
+            handle.resume();
+    }
+};
+
+/// @brief count the matches of two sources, awaiting one after the other
+template <typename Container>
+simplex::task<int> count_async(const Simplex<Container> &ex, chunk_source &first, chunk_source &second)
+{
+    int res = co_await ex.async_match(first) == simplex::status::match;
+    co_return res + (co_await ex.async_match(second) == simplex::status::match);
+}
+#endif
+
 #define TEST(expr, input, expected)                                                                                         \
     {                                                                                                                       \
-        constexpr auto ex{Simplex(expr)}; /* char[expr.size()] */                                                           \
+        constexpr auto ex{Simplex(expr)}; /* char[simplex::capacity(expr.size())] */                                      \
         constexpr std::string_view in{input##sv};                                                                           \
         bool matches = ex.matches(in);                                                                                      \
         if (matches != expected)                                                                                            \
@@ -14,8 +86,52 @@ using namespace std::literals;
             std::cerr << "[FAIL] Sex(\"" expr "\").matches(\"" input "\")!=" << (expected ? "true" : "false") << std::endl; \
             exitCode = 1;                                                                                                   \
         }                                                                                                                   \
+        COMPILED_TEST(expr, input, expected)                                                                                \
+    }
+
+#define SEARCH_TEST(expr, input, expected_pos, expected_len)                                                                         \
+    {                                                                                                                                 \
+        constexpr auto ex{Simplex(expr)};                                                                                             \
+        simplex::search_result found = ex.search(input##sv);                                                                          \
+        if (found.pos != size_t(expected_pos) || (found && found.len != size_t(expected_len)))                                        \
+        {                                                                                                                             \
+            std::cerr << "[FAIL] Sex(\"" expr "\").search(\"" input "\")!={" #expected_pos ", " #expected_len "}" << std::endl; \
+            exitCode = 1;                                                                                                             \
+        }                                                                                                                             \
     }
 
+#define FIND_ALL_TEST(expr, input, expected)                                                                      \
+    {                                                                                                             \
+        constexpr auto ex{Simplex(expr)};                                                                         \
+        std::string found;                                                                                        \
+        size_t n = 0;                                                                                             \
+        for (std::string_view match : ex.find_all(input##sv))                                                     \
+            found.append(n++ ? "|" : "").append(match);                                                           \
+        if (found != expected || ex.count(input##sv) != n)                                                        \
+        {                                                                                                         \
+            std::cerr << "[FAIL] Sex(\"" expr "\").find_all(\"" input "\")!=\"" expected "\"" << std::endl; \
+            exitCode = 1;                                                                                         \
+        }                                                                                                         \
+    }
+
+#define STATIC_TEST(expr, input, expected)                                                \
+    static_assert(Simplex(expr).matches(input##sv) == expected,                           \
+                  "Sex(\"" expr "\").matches(\"" input "\")!=" #expected " at compile time")
+
+STATIC_TEST("a*[bc]d", "abbbcd", true);
+STATIC_TEST("foo+ bar", "foobar", false);
+STATIC_TEST("foo{1,3} bar", "foo   bar", true);
+STATIC_TEST("foo{1,3} bar", "foo    bar", false);
+STATIC_TEST("+[-az-AZ-09_]", "foo_Bar9", true);
+STATIC_TEST("*!\n", "no newline", true);
+
+#if __cpp_nontype_template_args >= 201911L
+using namespace simplex::literals;
+static_assert("a*[bc]d"_sx.matches("abbbcd"));
+static_assert(!simplex::compiled<"foo{1,3}![ab]">::matches("foo    a"));
+static_assert(simplex::compiled<"a*[bc]d">::expr() == Simplex("a*[bc]d").expr());
+#endif
+
 int main()
 {
     int exitCode = 0;
@@ -58,6 +174,525 @@ int main()
     TEST("a{1,3}![-az-AZ-09_ \\]]", "a0 5", false);
     TEST("a{1,3}![-az-AZ-09_ \0]", "a}}}", true);
 
+    TEST("+[-az-AZ-09_]", "foo_Bar9", true);
+    TEST("+[-az-AZ-09_]", "-foo", false);
+    TEST("*![-az-AZ-09_]x", "$%^x", true);
+    TEST("[-\\-\\]]", "]", true);
+    TEST("[-\\-\\]]", "^", false);
+    TEST("[]", "a", false);
+    TEST("![]", "a", true);
+    TEST("!![ab]c", "cc", true);
+    TEST("!*[ab]c", "abc", false);
+
+    TEST("GET /api/v1/", "GET /api/v1/users", true);
+    TEST("GET /api/v1/", "GET /api/v2/users", false);
+    TEST("GET /api/v1/", "GET /api", false);
+    TEST("\\*\\*x!ab", "**xbb", true);
+    TEST("\\*\\*x!ab", "**xab", false);
+    TEST("ab*cd", "abcccd", true);
+    TEST("ab*cd", "acd", false);
+    TEST("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789x",
+         "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789x", true);
+    TEST("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789x",
+         "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789y", false);
+    static_assert(Simplex("GET /api").expr().size() == 10); // fused into a single STRING
+
+    SEARCH_TEST("foo* bar", "xx foo bar", 3, 7);
+    SEARCH_TEST("foo* bar", "xx fo foobar", 6, 6);
+    SEARCH_TEST("foo* bar", "xx fo fooba", simplex::npos, 0);
+    SEARCH_TEST("+[-09]", "id=1234;", 3, 4);
+    SEARCH_TEST("*[-09]x", "12y 34x", 4, 3);
+    SEARCH_TEST("*[-09]x", "y", simplex::npos, 0);
+    SEARCH_TEST("*[-09]", "y", 0, 0); // every character may begin an optional match
+    SEARCH_TEST("!?ab", "aab", 0, 3);
+    SEARCH_TEST("!a", "aaab", 3, 1);
+    SEARCH_TEST("{2,3}a", "aaaa aa", 1, 3);
+    static_assert(Simplex("+[-09]").search("id=1234;").pos == 3);
+
+    FIND_ALL_TEST("E+[-09]", "E1 ok E22 E E333", "E1|E22|E333");
+    FIND_ALL_TEST("{2,3}a", "aaaa aa a", "aaa|aa");
+    FIND_ALL_TEST("*[-09]", "a1b", "|1|"); // empty matches advance by one character
+    static_assert(Simplex("E+[-09]").count("E1 ok E22 E E333") == 3);
+    static_assert(Simplex("E+[-09]").count("no errors") == 0);
+
+    static_assert(Simplex("foo* ").match("foo   bar") == 6);
+    static_assert(Simplex("foo* ").match("fo") == simplex::npos);
+    static_assert(Simplex("+[-09]").full_match("1234"));
+    static_assert(!Simplex("+[-09]").full_match("1234;"));
+    static_assert(Simplex("a*b").full_match("abbb"));
+    {
+        constexpr auto ex{Simplex("+[-az]=")};
+        std::string input{"key=value"};
+        auto rest = ex.match(input.begin(), input.end());
+        if (!rest || std::string(*rest, input.end()) != "value" || ex.match(input.begin() + 1, input.begin() + 3))
+        {
+            std::cerr << "[FAIL] Sex(\"+[-az]=\").match(\"key=value\") did not end at \"value\"" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    // optimized programs, each checked against the program it is equivalent to
+    static_assert(Simplex("a{2,5}a").expr() == Simplex("{3,6}a").expr());
+    static_assert(Simplex("xa{1,5}a").expr() == Simplex("x{2,6}a").expr());
+    static_assert(Simplex("[a]*[b]c").expr() == Simplex("a*bc").expr());
+    static_assert(Simplex("{0,0}ab").expr() == Simplex("b").expr() && Simplex("{1,1}ab").expr().size() == 4);
+    static_assert(Simplex("{0,1}a{0,}b{1,}c").expr() == Simplex("?a*b+c").expr());
+    static_assert(Simplex("*a{0,3}ab").expr() == Simplex("*ab").expr());
+    static_assert(Simplex("{0,0}a").expr().size() == 5 && Simplex("{1,1}a").expr().size() == 5); // kept, a trailing 'a' would fail
+    TEST("{1,1}ab", "aab", false);
+    TEST("b{0,0}a", "b", false);
+    TEST("a?a", "a", false);
+    TEST("a{2,5}a", "aaaaaa", true);
+    TEST("a{2,5}a", "aaaaaaa", false);
+
+    // long runs are consumed by the SIMD kernels, check every length around the vector widths
+    for (size_t n = 0; n < 100; ++n)
+    {
+        std::string run(n, 'a'), mixed;
+        for (size_t i = 0; i < n; ++i)
+            mixed += "aZ_\x80"[i % 4];
+        bool ok = Simplex("*ab").match(run + "b") == n + 1 &&
+                  Simplex("*!\nb").match(run + "\nb") == simplex::npos &&
+                  Simplex("*!\n\n").match(run + "\n") == n + 1 &&
+                  Simplex("*[-az]0").match(run + "0") == n + 1 &&
+                  Simplex("*![-09]0").match(mixed + "0") == n + 1 &&
+                  Simplex("*[-az-AZ_\x80]").match(mixed + "-") == n &&
+                  Simplex("{0,40}ab").full_match(run + "b") == (n <= 40) &&
+                  Simplex("{0,40}![b]b").full_match(run + "b") == (n <= 40);
+#if __cpp_nontype_template_args >= 201911L
+        ok = ok && simplex::compiled<"*![-09]0">::matches(mixed + "0") && simplex::compiled<"{1,40}a">::matches(run) == (n >= 1 && n <= 40);
+#endif
+        if (!ok)
+        {
+            std::cerr << "[FAIL] quantified run of length " << n << std::endl;
+            exitCode = 1;
+        }
+    }
+    {
+        // quantifiers are unbounded, and explicit bounds are only limited to 64 bits
+        std::string line(5000, 'x'), blob(3u << 20, 'a');
+        auto ex{Simplex<std::string>("{300,400}a", simplex::capacity(10), '\0')};
+        constexpr auto run{Simplex("+a")};
+        simplex::stream_matcher chunked = run.stream();
+        for (size_t i = 0; i < blob.size(); i += 4096)
+            chunked.feed(std::string_view(blob).substr(i, 4096));
+        bool ok = Simplex("*!\n\n").match(line + "\n") == line.size() + 1 && run.full_match(blob) &&
+                  Simplex("{2000000,}a").full_match(blob) && !Simplex("{0,2000000}a").matches(blob) &&
+                  ex.full_match(blob.substr(0, 350)) && !ex.matches(blob.substr(0, 401)) && !ex.matches(blob.substr(0, 299)) &&
+                  chunked.finish() == simplex::status::match && chunked.consumed() == blob.size();
+#if __cpp_nontype_template_args >= 201911L
+        ok = ok && simplex::compiled<"{300,400}a">::matches(blob.substr(0, 400)) && simplex::compiled<"+a">::matches(blob);
+#endif
+        bool thrown{false};
+        try
+        {
+            Simplex<std::string>("{99999999999999999999,}a", simplex::capacity(24), '\0');
+        }
+        catch (const std::logic_error &)
+        {
+            thrown = true;
+        }
+        if (!ok || !thrown)
+        {
+            std::cerr << "[FAIL] unbounded and large quantifiers" << std::endl;
+            exitCode = 1;
+        }
+    }
+    static_assert(Simplex("{200,300}a").expr().size() == 7); // two byte varint bounds
+    static_assert(Simplex("{18446744073709551614,}a").matches("a") == false);
+    SEARCH_TEST("[-09]", "no digits until the very end of this long input 7", 48, 1);
+
+    // 8-bit literals and groups, matched over any byte type
+    static_assert(Simplex("\x89PNG\r\n").matches("\x89PNG\r\n\x1A\n"));
+    static_assert(Simplex("[\xFF]").expr() == Simplex("\xFF").expr() && Simplex("{2,3}[-\x80\xFF]!\xFE").matches("\xC3\xA9z"));
+    static_assert(!Simplex("\x81\x82").matches("\x81\x81") && Simplex("+\x83!\x84").matches("\x83\x83\x85"));
+    TEST("*!\x80\x80", "abc\x80", true);
+    TEST("\xE9+[-\xA0\xBF]", "\xE9\xA0\xBF\xC0", true);
+    {
+        const uint8_t packet[]{0x16, 0x03, 0x01, 0x02, 0x00, 0x01};
+        const std::vector<std::byte> bytes{std::byte(0xCA), std::byte(0xFE), std::byte(0xBA), std::byte(0xBE)};
+        constexpr auto tls{Simplex("\x16\x03[-\x00\x04]")};
+        constexpr auto magic{Simplex("\xCA\xFE*[\xBA\xBE]")};
+        auto rest = tls.match(std::begin(packet), std::end(packet));
+        bool ok = rest && *rest == packet + 3 && !tls.matches(packet + 1, std::end(packet)) && magic.full_match(bytes.begin(), bytes.end());
+        ok = ok && Simplex<std::string>("!a!a!a!a", simplex::capacity(8), '\0').matches("bcde") && tls.partial_match(packet, packet + 2) == simplex::status::need_more;
+#if __cpp_nontype_template_args >= 201911L
+        ok = ok && simplex::compiled<"\x16\x03{1,4}[-\x00\x04]">::matches(std::begin(packet), std::end(packet));
+#endif
+        if (!ok)
+        {
+            std::cerr << "[FAIL] Sex() over binary input" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    // UTF-8 mode, "!" and groups match whole codepoints
+    static_assert(Simplex("!a", simplex::encoding::utf8).match("\u00E9a") == 2 && Simplex("!a").match("\u00E9a") == 1);
+    static_assert(Simplex("+[-\u00E0\u00FF]", simplex::encoding::utf8).full_match("\u00E9t\u00E9") == false);
+    static_assert(Simplex("{2,3}[-az-\u00E0\u00FF]!\u20AC", simplex::encoding::utf8).match("\u00E9t\u00E9\u00A3") == 7);
+    static_assert(Simplex("*!\u20AC\u20AC", simplex::encoding::utf8).matches("prix: 5\u00A3 ou 6\u20AC"));
+    static_assert(Simplex("\u00E9t\u00E9", simplex::encoding::utf8).expr() == Simplex("\u00E9t\u00E9").expr()); // plain literals are bytes
+    static_assert(Simplex("!x", simplex::encoding::utf8).matches("\xA9") && !Simplex("[\u00E9]x", simplex::encoding::utf8).matches("\xC3x"));
+    {
+        constexpr auto word{Simplex("+[-az-AZ-\u00C0\u024F]", simplex::encoding::utf8)};
+        std::string text(100, 'a');
+        text += "\u00E7\u00E3o";
+        bool ok = word.match(text) == text.size() && word.search("  na\u00EFve!").pos == 2 && word.search("  na\u00EFve!").len == 6;
+        ok = ok && word.partial_match("caf\xC3") == simplex::status::need_more && word.count("h\u00E9 l\u00E0 \u4E16") == 2;
+        SimplexSet set;
+        set.add("![-az]+a", simplex::encoding::utf8);
+        ok = ok && set.matches("\u00E9aa") == std::vector<size_t>{0} && set.matches("baa").empty();
+        auto ex{Simplex<std::string>(simplex::encoding::utf8, "{1,2}!a", simplex::capacity(7), '\0')};
+        ok = ok && ex.matches("\u00E9\u00E9") && !ex.matches("\u00E9\u00E9\u00E9");
+#if __cpp_nontype_template_args >= 201911L
+        ok = ok && simplex::compiled<"{3,3}![ ] !a", simplex::encoding::utf8>::matches("\u20AC\u00E9x \U0001F600"sv);
+#endif
+        if (!ok)
+        {
+            std::cerr << "[FAIL] Sex(\"+[-az-AZ-\u00C0\u024F]\", utf8)" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        // every way of splitting the input into two chunks, and one character at a time, agrees with matches()
+        const char *exprs[]{"GET /api/v1/", "ab*cd", "{1,3}a!b", "!{2,3}ab", "*[-09]x", "a?b{0,2}c", "+a", "!*[ab]c", "{0,40}ab", "*!\u00E9\u00E9!a", "{1,2}[-\u00E0\u00FF]x"};
+        const char *inputs[]{"GET /api/v1/users", "GET /api/v2", "abcccd", "acd", "aab", "aaaab", "ab", "aaaa", "12x", "x", "abbc", "ac", "aaaaaa", "abc", "cc", "", "\u20AC\u00E9\u00E9x", "\u00E0\u00FFx", "\u00E0\u00FF\u00E9x", "\u00E9\xC3"};
+        for (size_t i = 0; i < std::size(exprs) * 2; ++i)
+        {
+            const char *expr = exprs[i / 2];
+            auto ex{Simplex<std::string>(i % 2 ? simplex::encoding::utf8 : simplex::encoding::bytes, expr, simplex::capacity(std::strlen(expr)), '\0')};
+            for (std::string_view input : inputs)
+            {
+                size_t len = ex.match(input);
+                for (size_t split = 0; split <= input.size() + 1; ++split)
+                {
+                    simplex::stream_matcher m = ex.stream();
+                    if (split > input.size())
+                    {
+                        for (char c : input)
+                            m.feed(std::string_view(&c, 1));
+                    }
+                    else
+                        m.feed(input.substr(0, split)), m.feed(input.substr(split));
+                    if ((m.finish() == simplex::status::match) != (len != simplex::npos) || (len != simplex::npos && m.consumed() != len))
+                    {
+                        std::cerr << "[FAIL] Sex(\"" << expr << "\").stream() on \"" << input << "\" split at " << split << std::endl;
+                        exitCode = 1;
+                    }
+                }
+            }
+        }
+    }
+    {
+        // single-pass input, read straight from a stream without buffering
+        std::istringstream stream("GET /api/v1/users?id=42 HTTP/1.1");
+        std::istreambuf_iterator<char> it(stream), end;
+        auto rest = Simplex("GET /api/v1/+![?]\\?").match(it, end);
+        std::string remaining(rest ? *rest : end, end);
+        const std::string input{"aaab12345x"};
+        std::vector<int> reads(input.size());
+        counting_iterator begin{input.data(), &reads, input.data()}, stop{input.data() + input.size(), &reads, input.data()};
+        bool counted = Simplex("*ab{1,9}[-09]x").matches(begin, stop) && reads == std::vector<int>(input.size(), 1);
+        if (!rest || remaining != "id=42 HTTP/1.1" || !Simplex("+a").full_match(begin, counting_iterator{input.data() + 3, &reads, input.data()}) || !counted)
+        {
+            std::cerr << "[FAIL] Sex().matches() with single-pass input iterators" << std::endl;
+            exitCode = 1;
+        }
+    }
+    {
+        // UTF-8 classes with single-pass input, a quantified class would have to read the codepoint after its run twice
+        std::istringstream single("\u00E9"), quantified("\u00E9\u00E9a");
+        bool ok = Simplex("!a", simplex::encoding::utf8).full_match(std::istreambuf_iterator<char>(single), std::istreambuf_iterator<char>());
+        try
+        {
+            Simplex("*!a", simplex::encoding::utf8).matches(std::istreambuf_iterator<char>(quantified), std::istreambuf_iterator<char>());
+            ok = false;
+        }
+        catch (const std::logic_error &)
+        {
+        }
+        std::istringstream streamed("\u00E9\u00E9a");
+        const auto ex = Simplex("*!aa", simplex::encoding::utf8);
+        simplex::stream_matcher m = ex.stream(); // the stream matcher keeps a cut off codepoint for the next chunk instead
+        for (std::istreambuf_iterator<char> it(streamed), end; it != end; ++it)
+        {
+            char c = *it;
+            m.feed(std::string_view(&c, 1));
+        }
+        if (!ok || m.finish() != simplex::status::match)
+        {
+            std::cerr << "[FAIL] Sex(..., simplex::encoding::utf8) with single-pass input iterators" << std::endl;
+            exitCode = 1;
+        }
+    }
+#if __cpp_impl_coroutine >= 201902L && __cpp_lib_coroutine >= 201902L
+    {
+        constexpr auto ex{Simplex("GET +!\n\n")};
+        chunk_source good, bad, truncated, first, second;
+        simplex::task<simplex::status> matching = ex.async_match(good), failing = ex.async_match(bad), ending = ex.async_match(truncated);
+        matching.resume(), failing.resume(), ending.resume();
+        bool ok = !matching.done() && !failing.done() && !ending.done();
+        good.push("GE"), good.push("T /index");
+        ok = ok && !matching.done();
+        good.push(".html\nHost: example.com");
+        bad.push("POST /");
+        truncated.push("GET /"), truncated.push("");
+        ok = ok && matching.done() && matching.result() == simplex::status::match && good.next == 3;
+        ok = ok && failing.done() && failing.result() == simplex::status::no_match;
+        ok = ok && ending.done() && ending.result() == simplex::status::no_match;
+        simplex::task<int> counting = count_async(ex, first, second);
+        counting.resume();
+        first.push("GET /\n"), second.push("GET");
+        ok = ok && !counting.done();
+        second.push(" /x\n");
+        if (!ok || !counting.done() || counting.result() != 2)
+        {
+            std::cerr << "[FAIL] Sex(\"GET +!\\n\\n\").async_match()" << std::endl;
+            exitCode = 1;
+        }
+    }
+#endif
+    static_assert(Simplex("GET /api/").partial_match("GET /a") == simplex::status::need_more);
+    static_assert(Simplex("GET /api/").partial_match("GET /b") == simplex::status::no_match);
+    static_assert(Simplex("GET /api/").partial_match("GET /api/v1") == simplex::status::match);
+    static_assert(Simplex("GET /api/").partial_match("") == simplex::status::need_more);
+    static_assert(Simplex("{0,2}a").partial_match("aa") == simplex::status::need_more); // "aaa" would not match
+    static_assert(Simplex("{0,2}a").partial_match("aaa") == simplex::status::no_match);
+    static_assert(Simplex("{0,2}ab").partial_match("aab") == simplex::status::match);
+    static_assert(Simplex("!{2,3}ab").partial_match("ab") == simplex::status::match);
+    {
+        constexpr auto ex{Simplex("+[-az]=+[-09];")};
+        std::string input{"key=12;"};
+        bool ok = ex.partial_match("key=x") == simplex::status::no_match && ex.partial_match("=") == simplex::status::no_match;
+        for (size_t n = 0; n <= input.size(); ++n)
+            ok = ok && ex.partial_match(input.begin(), input.begin() + n) == (n < input.size() ? simplex::status::need_more : simplex::status::match);
+        if (!ok)
+        {
+            std::cerr << "[FAIL] Sex(\"+[-az]=+[-09];\").partial_match()" << std::endl;
+            exitCode = 1;
+        }
+    }
+    static_assert(Simplex("ab*cd").stream().feed("abc") == simplex::status::need_more);
+    static_assert(Simplex("ab*cd").stream().feed("ac") == simplex::status::no_match);
+    static_assert(Simplex("ab*cd").stream().feed("abccdzz") == simplex::status::match);
+
+    {
+        SimplexSet set{"GET +!\n", "POST +!\n", "+[-AZ] /", "*[-az]", ""};
+        set.add(Simplex("GET /index"));
+        uint64_t bits[1]{};
+        set.matches("GET /index.html", bits);
+        if (set.size() != 6 || set.matches("GET /index.html") != std::vector<size_t>{0, 2, 3, 4, 5} || bits[0] != 0x3D ||
+            set.matches("POST /") != std::vector<size_t>{1, 2, 3, 4} || set.matches("") != std::vector<size_t>{4} || set.expr(5) != Simplex("GET /index").expr())
+        {
+            std::cerr << "[FAIL] SimplexSet::matches()" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        SimplexSet set{"a"};
+        bool ok{false};
+        try
+        {
+            set.add("ab{2,");
+        }
+        catch (const std::logic_error &)
+        {
+            ok = true;
+        }
+        // a failed add() leaves the set as it was
+        ok = ok && set.add("x") == 1 && set.size() == 2 && set.expr(1) == Simplex("x").expr() && set.matches("x") == std::vector<size_t>{1};
+        if (!ok)
+        {
+            std::cerr << "[FAIL] SimplexSet::add() after a syntax error" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        std::vector<std::string> rules;
+        for (size_t i = 0; i < 1000; ++i)
+            rules.push_back("user" + std::to_string(i) + (i % 2 ? "+[-09]" : "=*!;"));
+        SimplexArena arena(rules.begin(), rules.end()), utf8({"!a", "[-\u00E0\u00FF]"}, simplex::encoding::utf8);
+        bool ok = arena.size() == rules.size() && SimplexArena().size() == 0 && SimplexArena{""}.expr(0).empty() && SimplexArena{"", "a"}.matches(1, "a") && utf8.matches(0, "\u00E9") && utf8.match(1, "\u00FF") == 2;
+        for (size_t i = 0; ok && i < rules.size(); ++i)
+        {
+            ok = arena.expr(i) == Simplex<std::string>(rules[i], simplex::capacity(rules[i].size()), '\0').expr();
+            ok = ok && (i == 0 || arena.expr(i).data() == arena.expr(i - 1).data() + arena.expr(i - 1).size()); // back to back
+            ok = ok && arena.matches(i, "user" + std::to_string(i) + (i % 2 ? "7" : "=x;")) && !arena.full_match(i, "user" + std::to_string(i + 1));
+        }
+        try
+        {
+            SimplexArena{"a", "b{1"};
+            ok = false;
+        }
+        catch (const std::logic_error &)
+        {
+        }
+        if (!ok)
+        {
+            std::cerr << "[FAIL] SimplexArena" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        std::vector<std::string> rules{"GET +!\n", "{2,4}[-09]", "*[-az]", "", "user=*!;"};
+        SimplexArena arena(rules.begin(), rules.end());
+        std::string image = arena.serialize();
+        std::vector<uint64_t> mapped((image.size() + 7) / 8 + 1); // stands in for a page-aligned mapping
+        std::memcpy(mapped.data(), image.data(), image.size());
+        SimplexDatabase db(mapped.data(), image.size());
+        bool ok = image == arena.serialize() && db.size() == rules.size() && SimplexDatabase(SimplexArena().serialize().data(), 32).size() == 0;
+        for (size_t i = 0; ok && i < rules.size(); ++i)
+        {
+            ok = db.expr(i) == arena.expr(i) && db.matches(i, "GET /\n") == arena.matches(i, "GET /\n") && db.match(i, "2024") == arena.match(i, "2024");
+            ok = ok && db.full_match(i, "abc") == arena.full_match(i, "abc") && db.search(i, "x user=1; 99").pos == simplex::search(arena.expr(i), "x user=1; 99").pos;
+        }
+        ok = ok && db.search(4, "x user=1;").pos == 2 && db.search(1, "abc 12").len == 2 && !db.search(0, "PUT /\n");
+        auto rejected = [&mapped](size_t at, char byte, size_t size, size_t shift, const std::vector<uint64_t> *image = nullptr)
+        {
+            std::vector<uint64_t> copy(image ? *image : mapped);
+            reinterpret_cast<char *>(copy.data())[at] = byte;
+            try
+            {
+                SimplexDatabase(reinterpret_cast<char *>(copy.data()) + shift, size);
+                return false;
+            }
+            catch (const std::logic_error &)
+            {
+                return true;
+            }
+        };
+        ok = ok && rejected(0, 'S', image.size(), 0) && rejected(8, 2, image.size(), 0) && rejected(0, 's', image.size() - 1, 0) && rejected(0, 's', image.size() - 8, 8);
+        ok = ok && rejected(32, char(0xFF), image.size(), 0) && rejected(40, char(0xFF), image.size(), 0); // an expression outside of the image
+        std::vector<uint64_t> empty(4); // an empty image with a record, claiming to be smaller than its header
+        std::memcpy(empty.data(), SimplexArena().serialize().data(), 32);
+        ok = ok && rejected(16, 1, 32, 0, &empty) && rejected(24, 0, 32, 0, &empty) && (empty[2] = 1, rejected(24, 0, 32, 0, &empty));
+        if (!ok)
+        {
+            std::cerr << "[FAIL] SimplexDatabase" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        SimplexRegistry registry(3);
+        SimplexRegistry::handle get = registry.get("GET +!\n"), utf8 = registry.get("GET +!\n", simplex::encoding::utf8);
+        bool ok = registry.get("GET +!\n") == get && utf8 != get && get->expr() == Simplex("GET +!\n").expr() && get->data().size() == get->expr().size();
+        registry.get("a"), registry.get("b"), registry.get("GET +!\n"), registry.get("c"); // evicts the least recently used, utf8
+        ok = ok && registry.size() == 3 && registry.get("GET +!\n") == get && registry.get("GET +!\n", simplex::encoding::utf8) != utf8 && utf8->matches("GET /\n");
+        std::vector<std::thread> threads;
+        std::vector<SimplexRegistry::handle> shared(8);
+        for (size_t i = 0; i < shared.size(); ++i)
+            threads.emplace_back([&registry, &shared, i]
+                                 { shared[i] = registry.get("{2,4}[-09]"); });
+        for (std::thread &thread : threads)
+            thread.join();
+        for (const SimplexRegistry::handle &h : shared)
+            ok = ok && h == shared[0] && h->matches("2024");
+        try
+        {
+            registry.get("{2,");
+            ok = false;
+        }
+        catch (const std::logic_error &)
+        {
+        }
+        if (!ok || registry.size() != 3)
+        {
+            std::cerr << "[FAIL] SimplexRegistry::get()" << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    {
+        constexpr auto ex{Simplex("+[-az-AZ-09_]")};
+        std::vector<std::string_view> inputs;
+        std::string data;
+        std::vector<uint32_t> offsets{0};
+        for (size_t i = 0; i < 150; ++i)
+        {
+            inputs.push_back(i % 3 == 0 ? "ident_1"sv : i % 3 == 1 ? "-nope"sv : ""sv);
+            data.append(inputs.back());
+            offsets.push_back(uint32_t(data.size()));
+        }
+        std::vector<uint64_t> bits(3, ~uint64_t(0)), packed(3);
+        ex.matches_batch(inputs.data(), inputs.size(), bits.data());
+        ex.matches_batch(data.data(), offsets.data(), inputs.size(), packed.data());
+        bool ok = bits == packed && (bits[2] >> 22) == 0;
+#if __cpp_lib_span >= 202002L
+        std::vector<uint64_t> spanned(3);
+        ex.matches_batch(inputs, spanned);
+        ok = ok && spanned == bits;
+#endif
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            if (!ok || ((bits[i / 64] >> (i % 64)) & 1) != ex.matches(inputs[i]))
+            {
+                std::cerr << "[FAIL] Sex(\"+[-az-AZ-09_]\").matches_batch() at input " << i << std::endl;
+                exitCode = 1;
+                break;
+            }
+        }
+    }
+
+    {
+        // large enough to be split into chunks, with matches straddling the chunk boundaries
+        std::string big;
+        for (uint32_t i = 0, x = 1; i < (1u << 20) + 123; ++i)
+            x = x * 1103515245u + 12345u, big += "aaab \n"[(x >> 16) % 6];
+        auto check = [&](auto ex, const char *expr)
+        {
+            std::vector<std::string_view> all(ex.find_all(big).begin(), ex.find_all(big).end());
+            for (unsigned threads : {1u, 2u, 3u, 7u, 16u})
+            {
+                simplex::search_result first = ex.search(big.substr(big.size() / 2)), found = ex.parallel_search(big.substr(big.size() / 2), threads);
+                if (ex.parallel_count(big, threads) != all.size() || ex.parallel_find_all(big, threads) != all || found.pos != first.pos || found.len != first.len)
+                {
+                    std::cerr << "[FAIL] Sex(\"" << expr << "\") parallel scan with " << threads << " threads" << std::endl;
+                    exitCode = 1;
+                }
+            }
+        };
+        check(Simplex("+a"), "+a");
+        check(Simplex("a+ b"), "a+ b");
+        check(Simplex("*b"), "*b");
+        check(Simplex("{1,3}a"), "{1,3}a");
+        check(Simplex("+! "), "+! ");
+        check(Simplex("b\n"), "b\n");
+        check(Simplex("E+!\n"), "E+!\n");
+        big.replace(big.size() - 10, 3, "E \n"); // a single match, found by the last chunk only
+        check(Simplex("E+!\n"), "E+!\n");
+        // the number of threads is clamped to the number of chunks, and a failing chunk is rethrown once every thread is joined
+        bool ok = Simplex("b\n").parallel_count(big, 1u << 30) == Simplex("b\n").count(big);
+        try
+        {
+            simplex::internal::parallel_chunks(4 * simplex::internal::parallel_min_chunk, 4, [](size_t i, size_t, size_t)
+                                               {
+                                                   if (i == 2)
+                                                       throw std::runtime_error("chunk"); });
+            ok = false;
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        if (!ok)
+        {
+            std::cerr << "[FAIL] simplex::internal::parallel_chunks()" << std::endl;
+            exitCode = 1;
+        }
+        // matches beginning before a limit may end past it
+        constexpr auto plus = Simplex("+a");
+        simplex::match_range range = plus.find_all("xxaaa");
+        if (range.next(0, 2) || range.next(0, 3).pos != 2 || range.next(0, 3).len != 3 || range.next(3, 3))
+        {
+            std::cerr << "[FAIL] match_range::next() with a limit" << std::endl;
+            exitCode = 1;
+        }
+    }
+
     std::cout << std::endl;
     if (exitCode == 0)
         std::cout << "[PASS] all tests passed";